@@ -0,0 +1,123 @@
+#ifndef ABSORBING_LAYER_H
+#define ABSORBING_LAYER_H
+
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+#include "../include/kernels.h"
+#include "../include/boundary.h"
+
+/**
+ * Perfectly matched layer along the edges of the grid. Waves entering it are
+ * damped without reflecting off its inner side, so a layer of 16 to 32 cells
+ * stands in for open water beyond the edge. The layer takes up grid cells; the
+ * water of interest lies inside it.
+ *
+ * The auxiliary fields are stored for layer cells only (see BasicPmlFields) and
+ * double buffered by step parity, so the velocity update of a cell may read the
+ * fields of its neighbours while they are being advanced.
+ *
+ * @tparam Storage Element type of the height and velocity arrays
+ */
+template <typename Storage = float>
+class AbsorbingLayer {
+public:
+    using Compute = typename ComputeType<Storage>::type;
+    using Fields = BasicPmlFields<Storage>;
+
+    /**
+     * Constructor - no layer on any edge
+     * @param width Grid width
+     * @param height Grid height
+     */
+    AbsorbingLayer(int width, int height);
+
+    /**
+     * Set the layer along one edge and clear the fields of every edge. The damping
+     * grows with the square of the depth into the layer, to the strength at which a
+     * wave crossing the layer and back would keep the given fraction of its amplitude
+     * in the continuous equations.
+     * @param edge Edge to set
+     * @param thickness Layer thickness in cells, 0 to remove it
+     * @param reflection Theoretical reflection coefficient at normal incidence
+     * @param speed Wave speed in cells per second
+     */
+    void set(Edge edge, int thickness, float reflection, Compute speed);
+
+    /**
+     * Layer thickness at one edge
+     * @return Thickness in cells
+     */
+    int thickness(Edge edge) const;
+
+    /**
+     * Check whether any edge has a layer
+     */
+    bool active() const;
+
+    /**
+     * Check whether a region contains layer cells
+     */
+    bool overlaps(const KernelRegion& region) const;
+
+    /**
+     * Fields for the velocity update of one step
+     * @param step Steps run before this one; its parity picks the buffers
+     */
+    Fields fields(uint64_t step);
+
+    /**
+     * Split a region into the parts in the layer, each suitable for the layer kernel,
+     * and the part inside it
+     * @param region Cells to split
+     * @param visit Called with each non-empty part and whether it lies in the layer
+     */
+    template <typename Visit>
+    void for_each_part(const KernelRegion& region, Visit&& visit) const {
+        // Whole rows above and below, then the rows in between split into left, inside and right
+        const int middle_begin = std::clamp(m_top, region.y_begin, region.y_end);
+        const int middle_end = std::clamp(m_height - m_bottom, middle_begin, region.y_end);
+        if (region.y_begin < middle_begin) {
+            visit(KernelRegion{region.x_begin, region.x_end, region.y_begin, middle_begin}, true);
+        }
+        if (middle_begin < middle_end) {
+            const int left_end = std::clamp(m_left, region.x_begin, region.x_end);
+            const int right_begin = std::clamp(m_width - m_right, left_end, region.x_end);
+            if (region.x_begin < left_end) {
+                visit(KernelRegion{region.x_begin, left_end, middle_begin, middle_end}, true);
+            }
+            if (left_end < right_begin) {
+                visit(KernelRegion{left_end, right_begin, middle_begin, middle_end}, false);
+            }
+            if (right_begin < region.x_end) {
+                visit(KernelRegion{right_begin, region.x_end, middle_begin, middle_end}, true);
+            }
+        }
+        if (middle_end < region.y_end) {
+            visit(KernelRegion{region.x_begin, region.x_end, middle_end, region.y_end}, true);
+        }
+    }
+
+private:
+    int m_width;
+    int m_height;
+    int m_left;
+    int m_right;
+    int m_top;
+    int m_bottom;
+    float m_sigma_max[static_cast<int>(Edge::Count)];  // Damping at the outer face of each edge's layer
+
+    std::vector<int64_t> m_row_start;
+    std::vector<Storage> m_psi_x[2];
+    std::vector<Storage> m_psi_y[2];
+    std::vector<Storage> m_sigma_x;
+    std::vector<Storage> m_sigma_x_face;
+    std::vector<Compute> m_sigma_y;
+    std::vector<Compute> m_sigma_y_face;
+
+    void rebuild();
+    static float profile(float position, int inner_end, int outer_begin, int before, int after,
+                         float sigma_before, float sigma_after);
+};
+
+#endif // ABSORBING_LAYER_H
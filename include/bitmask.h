@@ -0,0 +1,92 @@
+#ifndef BITMASK_H
+#define BITMASK_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+/**
+ * Read 64 consecutive bits of a packed bit array
+ * @param words Bit array, bit i lives in words[i / 64] at position i % 64
+ * @param pos Index of the first bit
+ * @return Bits pos..pos+63, bit pos in the least significant position
+ */
+inline uint64_t load_bits(const uint64_t* words, const size_t pos) {
+    const size_t word = pos / 64;
+    const unsigned shift = pos % 64;
+    if (shift == 0) {
+        return words[word];
+    }
+    return (words[word] >> shift) | (words[word + 1] << (64 - shift));
+}
+
+class BitMask {
+public:
+    BitMask() = default;
+
+    /**
+     * Resize the mask and set every bit
+     * @param bits Number of bits
+     * @param value Value of every bit
+     */
+    void assign(size_t bits, bool value);
+
+    /**
+     * Read one bit
+     * @param pos Bit index
+     */
+    bool test(size_t pos) const {
+        return (m_words[pos / 64] >> (pos % 64)) & 1u;
+    }
+
+    /**
+     * Write one bit
+     * @param pos Bit index
+     * @param value New value
+     */
+    void set(size_t pos, bool value) {
+        const uint64_t bit = uint64_t{1} << (pos % 64);
+        m_words[pos / 64] = value ? (m_words[pos / 64] | bit) : (m_words[pos / 64] & ~bit);
+    }
+
+    /**
+     * Write a range of bits, a word at a time
+     * @param pos Index of the first bit
+     * @param count Number of bits
+     * @param value New value
+     */
+    void fill(size_t pos, size_t count, bool value);
+
+    /**
+     * Copy a range of bits from another packed bit array, a word at a time
+     * @param pos Index of the first bit written
+     * @param words Source bit array, read with load_bits
+     * @param from Index of the first bit read
+     * @param count Number of bits
+     */
+    void copy(size_t pos, const uint64_t* words, size_t from, size_t count);
+
+    /**
+     * Read 64 bits starting at any position, see load_bits
+     */
+    uint64_t load(size_t pos) const {
+        return load_bits(m_words.data(), pos);
+    }
+
+    /**
+     * Packed words. One spare word past the end keeps load_bits in range for the last bit.
+     */
+    const uint64_t* data() const {
+        return m_words.data();
+    }
+
+    size_t size() const {
+        return m_bits;
+    }
+
+private:
+    std::vector<uint64_t> m_words;
+    size_t m_bits = 0;
+};
+
+#endif // BITMASK_H
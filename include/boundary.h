@@ -0,0 +1,149 @@
+#ifndef BOUNDARY_H
+#define BOUNDARY_H
+
+#include <vector>
+#include "../include/kernels.h"
+#include "../include/bitmask.h"
+
+/**
+ * Edge of the grid. Row 0 is the top edge.
+ */
+enum class Edge {
+    Left,
+    Right,
+    Top,
+    Bottom,
+    Count
+};
+
+/**
+ * Edge on the other side of the grid
+ */
+inline Edge opposite_edge(const Edge edge) {
+    switch (edge) {
+        case Edge::Left: return Edge::Right;
+        case Edge::Right: return Edge::Left;
+        case Edge::Top: return Edge::Bottom;
+        default: return Edge::Top;
+    }
+}
+
+/**
+ * How waves behave where they meet an edge of the grid
+ */
+enum class BoundaryKind {
+    Reflective,  // Edge cells hold still and waves bounce back (default)
+    Periodic,    // Waves leaving through an edge re-enter through the opposite one
+    Absorbing,   // First-order Sommerfeld (Mur) radiation condition: waves leave the grid
+    WaveMaker    // Edge heights follow a sine and send waves into the grid
+};
+
+/**
+ * Boundary conditions of the four grid edges. Only edge cells are touched, so
+ * applying them costs O(width + height) per step rather than a sweep of the grid.
+ *
+ * After a velocity update the edge cells of the updated region get their velocity
+ * from the condition of their edge. Corner cells follow the left or right edge
+ * unless that edge is periodic. Periodic edges work through the ghost border
+ * instead: it is marked wet and holds a copy of the opposite edge's heights, so
+ * the stencil kernels wrap around without knowing about it.
+ *
+ * @tparam Storage Element type of the height and velocity arrays
+ */
+template <typename Storage = float>
+class BoundaryConditions {
+public:
+    using Compute = typename ComputeType<Storage>::type;
+    using Grid = BasicFluidGrid<Storage>;
+
+    /**
+     * Constructor - every edge reflective
+     */
+    BoundaryConditions();
+
+    /**
+     * Set the condition of one edge. Periodic pairs opposite edges, so making an
+     * edge periodic also makes the opposite edge periodic, and replacing a periodic
+     * edge makes the opposite edge reflective.
+     * @param edge Edge to set
+     * @param kind Condition of the edge
+     */
+    void set(Edge edge, BoundaryKind kind);
+
+    /**
+     * Make an edge a wave maker whose cells follow amplitude * sin(2 pi t / period)
+     * @param edge Edge to set
+     * @param amplitude Height amplitude
+     * @param period Period in seconds
+     */
+    void set_wave_maker(Edge edge, float amplitude, float period);
+
+    /**
+     * Condition of one edge
+     */
+    BoundaryKind kind(Edge edge) const;
+
+    /**
+     * Check whether every edge is reflective, the only condition that needs no state
+     * beyond the edge cells themselves
+     */
+    bool all_reflective() const;
+
+    /**
+     * Check whether the left and right edges wrap around
+     */
+    bool periodic_x() const;
+
+    /**
+     * Check whether the top and bottom edges wrap around
+     */
+    bool periodic_y() const;
+
+    /**
+     * Get ready to step: mark the ghost border wet where it stands in for the opposite
+     * edge of a periodic pair and dry elsewhere, and start the height history of edges
+     * that just became absorbing. Must run whenever conditions or obstacles change.
+     * @param grid The whole padded grid
+     * @param wet Obstacle map of the padded grid
+     */
+    void prepare(const Grid& grid, BitMask& wet);
+
+    /**
+     * Copy the heights of periodic edges into the ghost border on the opposite side,
+     * for the rows a band is about to step. Covers the left and right ghost cells of
+     * those rows, the top ghost row if the band starts at row 0 and the bottom ghost
+     * row if it ends at the last row. Only heights of other bands are read, so bands
+     * may fill concurrently while nobody writes heights.
+     * @param grid The whole padded grid, not a tile copy
+     * @param rows Rows about to be stepped; the x range is ignored
+     */
+    void fill_halo(const Grid& grid, const KernelRegion& rows) const;
+
+    /**
+     * Set the velocities of the edge cells within a region that was just given its
+     * velocity update. Reads heights of the current step only, so it must run before
+     * any height of the step changes next to an edge cell. Regions stepped
+     * concurrently must not overlap, and every edge cell is applied once per step.
+     * @param grid Simulation arrays, possibly a tile copy
+     * @param region Cells just updated
+     * @param dt Timestep
+     * @param speed Wave speed in cells per second
+     * @param time Simulated time at the end of the step
+     */
+    void apply(const Grid& grid, const KernelRegion& region, Compute dt, Compute speed, double time);
+
+private:
+    struct EdgeCondition {
+        BoundaryKind kind = BoundaryKind::Reflective;
+        float amplitude = 0.0f;        // Wave makers only
+        float period = 1.0f;
+        std::vector<Compute> history;  // Absorbing only: last height of the cell inside each edge cell
+    };
+    EdgeCondition m_edges[static_cast<int>(Edge::Count)];
+
+    const EdgeCondition& edge(Edge edge) const;
+    void applyCells(const Grid& grid, EdgeCondition& condition, int x, int y, int dx, int dy, int count,
+                    int inward, int position, Compute dt, Compute speed, double time);
+};
+
+#endif // BOUNDARY_H
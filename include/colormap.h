@@ -0,0 +1,68 @@
+#ifndef COLORMAP_H
+#define COLORMAP_H
+
+#include <cstdint>
+#include <vector>
+#include "../include/kernels.h"
+
+/**
+ * Colour schemes for the height field
+ */
+enum class Palette {
+    Blue,      // Blue intensity ramp over heights -1..1 (the original view)
+    Spectrum,  // Blue to green to red over heights 1..10 (the matplotlib plot)
+    Grayscale, // Black to white over heights -1..1
+    Diverging, // Blue troughs, white rest level, red crests over heights -1..1
+    Count
+};
+
+/**
+ * Precomputed colour lookup table. Heights are quantized to one of `levels`
+ * entries and obstacles get an entry of their own, so the per-cell work is
+ * a multiply, a clamp and a table read. Colours are packed RGBA bytes, the
+ * layout of SDL_PIXELFORMAT_RGBA32.
+ */
+class Colormap {
+public:
+    /**
+     * Constructor for the Colormap class
+     * @param palette Colour scheme
+     * @param levels Number of water entries, at most 4096
+     */
+    explicit Colormap(Palette palette = Palette::Blue, int levels = 256);
+
+    /**
+     * Rebuild the table for another colour scheme
+     * @param palette Colour scheme
+     */
+    void set_palette(Palette palette);
+
+    /**
+     * Colour scheme the table holds
+     * @return Palette
+     */
+    Palette palette() const;
+
+    /**
+     * Table in the form the colour-mapping kernels read it
+     * @return Lookup table, valid until the palette changes
+     */
+    const ColorLut& lut() const;
+
+    /**
+     * Human-readable palette name
+     * @param palette Colour scheme
+     * @return Name
+     */
+    static const char* name(Palette palette);
+
+private:
+    Palette m_palette;
+    int m_levels;
+    std::vector<uint32_t> m_colors;
+    ColorLut m_lut;
+
+    void build();
+};
+
+#endif // COLORMAP_H
@@ -2,11 +2,55 @@
 #define FLUID_H
 
 #include <vector>
-#include <thread>
-#include "../include/renderer.h"  // Assuming this includes SDL_Color
+#include <memory>
+#include <cstdint>
+#include <functional>
+#include "../include/kernels.h"
+#include "../include/precision.h"
+#include "../include/bitmask.h"
+#include "../include/boundary.h"
+#include "../include/absorbing_layer.h"
+#include "../include/thread_pool.h"
+#include "../include/fluid_snapshot.h"
+#include "../include/snapshot_channel.h"
+#include "../include/probe_recorder.h"
+#include "../include/profiler.h"
+#include "../include/perf_counters.h"
+#include "../include/scenario.h"
 
+/**
+ * How Fluid::step sweeps the grid. Every mode produces bit-identical results.
+ */
+enum class StepMode {
+    ThreePass,       // Separate velocity, boundary and height sweeps (reference)
+    Fused,           // One sweep, heights trailing the velocities by a row
+    TemporalBlocked, // Tiles advance several steps in cache before moving on
+    Sparse           // Only tiles near moving water are stepped
+};
+
+/**
+ * Parts of a step that hardware events are attributed to
+ */
+enum class PerfPhase {
+    Step,        // Whole batches, every mode
+    Velocities,  // Velocity sweeps, StepMode::ThreePass only
+    Boundaries,  // Boundary sweeps, StepMode::ThreePass only
+    Heights,     // Height sweeps, StepMode::ThreePass only
+    Count
+};
+
+/**
+ * Height-field water simulation
+ * @tparam Storage Element type of the height and velocity arrays: float, double,
+ *                 or Half to halve memory traffic while computing in float
+ */
+template <typename Storage = float>
 class Fluid {
 public:
+    using Compute = typename ComputeType<Storage>::type;
+    using Grid = BasicFluidGrid<Storage>;
+    using Kernels = BasicKernelSet<Storage>;
+
     /**
     * Constructor for the Fluid class
     * @param size 2D Size of the simulaiton
@@ -16,7 +60,6 @@ public:
     * @param screen_size 2D Size of the screen
     */
     Fluid(int height, int width, float dt, float c, float s, int screen_height, int screen_width);
-    ~Fluid();
 
     /**
      * Step through the simulation
@@ -25,61 +68,411 @@ public:
     void step(float halflife);
 
     /**
-     * Send the current state of the sim to the render buffer
-     * @param renderer Pointer to the renderer
+     * Run several steps back to back. Per-step constants are computed once and
+     * threads stay inside one parallel job for the whole batch.
+     * @param substeps Number of timesteps to run
+     * @param halflife Decay time for waves
+     */
+    void advance(int substeps, float halflife);
+
+    /**
+     * Simulated time since construction
+     * @return Time in seconds
+     */
+    double sim_time() const;
+
+    /**
+     * Steps run since construction
+     */
+    uint64_t step_count() const;
+
+    /**
+     * Timestep
+     * @return Timestep in seconds
+     */
+    double dt() const;
+
+    /**
+     * Read the height of one cell
+     * @param x X coordinate
+     * @param y Y coordinate
+     * @return Height, converted to double
+     */
+    double height_at(int x, int y) const;
+
+    /**
+     * Check whether a cell holds water rather than an obstacle
+     * @param x X coordinate
+     * @param y Y coordinate
+     * @return True if the cell is wet
+     */
+    bool is_wet(int x, int y) const;
+
+    /**
+     * Convert the height field into packed pixels, one per cell
+     * @param lut Colour lookup table
+     * @param pixels Pixel of cell (0, 0)
+     * @param pitch Row pitch of the pixel buffer in pixels
+     */
+    void map_colors(const ColorLut& lut, uint32_t* pixels, int pitch) const;
+
+    /**
+     * Copy the height field and obstacle map for use on another thread. The
+     * snapshot's buffers are reused, so repeated captures do not allocate.
+     * @param snapshot Snapshot to overwrite
+     */
+    void capture(FluidSnapshot<Storage>& snapshot) const;
+
+    /**
+     * Publish a downsampled snapshot into the channel every `cadence` steps.
+     * Batched steps stop at each due step, so every frame shows the grid at
+     * exactly a multiple of the cadence.
+     * @param channel Channel to feed; must match the grid size and outlive its registration
+     */
+    void add_snapshot_channel(SnapshotChannel& channel);
+
+    /**
+     * Register a wave gauge; exits while a recorder is attached, whose records are
+     * sized for the probes registered before it
+     * @param x X coordinate of the cell
+     * @param y Y coordinate of the cell
+     * @return Index of the probe within each record
+     */
+    int add_probe(int x, int y);
+
+    /**
+     * Record every probe on every substep. Samples are taken inside the step
+     * sweep, while each band or tile is still in cache.
+     * @param recorder Recorder sized for the registered probes, or nullptr to stop recording
+     */
+    void record_probes(ProbeRecorder* recorder);
+
+    /**
+     * Stop feeding a channel
+     * @param channel Channel passed to add_snapshot_channel
+     */
+    void remove_snapshot_channel(SnapshotChannel& channel);
+
+    /**
+     * Grid width
+     * @return Width in cells
+     */
+    int width() const;
+
+    /**
+     * Grid height
+     * @return Height in cells
      */
-    void render(const Renderer* renderer);
+    int height() const;
 
     /**
      * Add velocity in a circle around to point to initiate a wave
      * @param x x coordinate on screen
      * @param y Y coordinate on screen
+     * @param strength Velocity at the centre of the splash
+     */
+    void add_velocity(int x, int y, float strength = 20000.0f);
+
+    /**
+     * Remove every obstacle, leaving the whole grid wet and fully open
+     */
+    void clear_obstacles();
+
+    /**
+     * Place a rectangular structure. Porous structures such as rubble mounds and
+     * perforated breakwaters pass part of each wave and reflect the rest; a face
+     * between two cells transmits in proportion to the smaller porosity of the
+     * two. While every cell is solid or fully open the kernels only read the
+     * obstacle bitmask. Porous cells inside an absorbing layer count as open.
+     * @param x X coordinate of the top left cell
+     * @param y Y coordinate of the top left cell
+     * @param width Width in cells
+     * @param height Height in cells
+     * @param porosity Open fraction of each cell: 0 solid, 1 open water
+     */
+    void add_structure(int x, int y, int width, int height, float porosity = 0.0f);
+
+    /**
+     * Open fraction of one cell
+     * @param x X coordinate
+     * @param y Y coordinate
+     * @return 0 for obstacles, 1 for open water, in between for porous cells
      */
-    void add_velocity(int x, int y);
+    float porosity(int x, int y) const;
 
     /**
-     *
+     * Add a Sierpinski carpet of structures, see Scenario::sierpinski_carpet
      * @param x X coordinate
      * @param y Y coordinate
      * @param size Size in pixels
-     * @param level Recursion depth of the carpet
+     * @param level Depth of the carpet
+     * @param porosity Open fraction of the carpet's cells, see add_structure
      */
-    void generate_sierpinski_carpet(int x, int y, int size, int level);
+    void generate_sierpinski_carpet(int x, int y, int size, int level, float porosity = 0.0f);
+
+    /**
+     * Replace every obstacle, porous structure and medium field with a scenario,
+     * rasterized by all threads. With a cache directory the rasterized map is kept
+     * in a file named after Scenario::hash and reused while scene and grid are
+     * unchanged.
+     * @param scenario Scene to load
+     * @param cache_dir Existing directory for cached maps, empty for no cache
+     * @return True if the map came from the cache
+     */
+    bool load_scenario(const Scenario& scenario, const std::string& cache_dir = std::string());
+
+    /**
+     * Override the kernel set picked for this CPU, e.g. to run the scalar reference
+     * @param kernels Kernel set to use for subsequent steps
+     */
+    void set_kernels(const Kernels& kernels);
+
+    /**
+     * Set how many threads step through the simulation. The grid is split into
+     * one band of rows per thread.
+     * @param threads Thread count, 0 for every hardware thread
+     */
+    void set_threads(int threads);
+
+    /**
+     * Select how each step sweeps the grid
+     * @param mode Step mode, Fused by default
+     */
+    void set_step_mode(StepMode mode);
+
+    /**
+     * Set how waves behave at one edge of the grid; every edge starts reflective.
+     * Periodic pairs opposite edges, see BoundaryConditions::set. Absorbing edges let
+     * waves leave, so the grid can end close to the region of interest. Any condition
+     * other than Reflective makes StepMode::TemporalBlocked step like StepMode::Fused.
+     * @param edge Edge to set
+     * @param kind Condition of the edge
+     */
+    void set_boundary(Edge edge, BoundaryKind kind);
+
+    /**
+     * Drive one edge with a sine: its wet cells follow amplitude * sin(2 pi t / period)
+     * @param edge Edge to set
+     * @param amplitude Height amplitude
+     * @param period Period in seconds
+     */
+    void set_wave_maker(Edge edge, float amplitude, float period);
+
+    /**
+     * Condition of one edge
+     */
+    BoundaryKind boundary(Edge edge) const;
+
+    /**
+     * Line one edge with a perfectly matched layer that soaks up outgoing waves,
+     * reflecting well under 1% at 16 to 32 cells, far less than an absorbing edge
+     * condition. The layer occupies the outermost cells of the grid, so enlarge the
+     * grid by its thickness. Setting a layer restarts every edge's layer fields.
+     * Like non-reflective edges, a layer makes StepMode::TemporalBlocked step like
+     * StepMode::Fused, and StepMode::Sparse keeps stepping the layer.
+     * @param edge Edge to line; must not be periodic
+     * @param thickness Thickness in cells, 0 to remove the layer
+     * @param reflection Reflection at normal incidence the damping profile is designed for
+     */
+    void set_absorbing_layer(Edge edge, int thickness, float reflection = 1e-3f);
+
+    /**
+     * Give every cell its own wave speed and extra damping, e.g. from bathymetry:
+     * waves slow down over shallow water (c = sqrt(g * depth)) and lose energy over
+     * reefs or vegetation. While both are uniform the plain kernels run at no extra
+     * cost. Cells of an absorbing layer keep the uniform coefficients.
+     * @param speed Wave speed per cell, row-major; at most c, which sets the stable
+     *              timestep. Empty for c everywhere
+     * @param damping_rate Decay rate per cell in 1/s, on top of the halflife passed
+     *                     to step. Empty for none
+     */
+    void set_medium(const std::vector<float>& speed, const std::vector<float>& damping_rate);
+
+    /**
+     * Configure StepMode::TemporalBlocked. Each tile is copied together with a
+     * halo of `depth` cells and advanced `depth` steps in cache; the halo cells
+     * are recomputed by neighbouring tiles.
+     * @param depth Steps per pass over the grid
+     * @param tile_size Tile edge length in cells
+     */
+    void set_temporal_blocking(int depth, int tile_size);
+
+    /**
+     * Configure StepMode::Sparse. A tile goes still once its largest |V| stayed at
+     * or below the threshold for two consecutive steps, and is stepped again as
+     * soon as a neighbouring tile moves. A threshold of 0 skips only water that
+     * is exactly at rest and keeps results identical to the other modes.
+     * @param tile_size Tile edge length in cells
+     * @param threshold Velocity below which water counts as still
+     */
+    void set_sparse_tracking(int tile_size, float threshold);
+
+    /**
+     * Share of tiles stepped during the last substep in StepMode::Sparse
+     * @return Fraction between 0 and 1
+     */
+    float active_fraction() const;
+
+    /**
+     * Keep decaying waves out of the subnormal range, where float arithmetic can be
+     * 10-100x slower. Once a velocity is subnormal, damping rounds it back to the
+     * same value, so it never decays to zero by itself.
+     * @param flush_denormals Set flush-to-zero and denormals-are-zero on every thread
+     *                        while it steps (x86 and AArch64)
+     * @param epsilon Velocities smaller in magnitude are stored as exactly zero; 0 keeps
+     *                every value and results identical to running without protection
+     */
+    void set_denormal_protection(bool flush_denormals, float epsilon);
+
+    /**
+     * Share of wet cells whose velocity is exactly zero. Such cells also let
+     * StepMode::Sparse put their tiles to rest. Scans the whole grid.
+     * @return Fraction between 0 and 1
+     */
+    float resting_fraction() const;
+
+    /**
+     * Count hardware events on every stepping thread. Batches are counted whole in
+     * every mode; StepMode::ThreePass also attributes its velocity, boundary and
+     * height sweeps, which the fused modes interleave row by row.
+     * @param enabled True to start counting from zero, false to stop
+     * @return False if the counters are unavailable on this system
+     */
+    bool set_perf_counters(bool enabled);
+
+    /**
+     * Events counted since set_perf_counters(true), summed over threads
+     * @param phase Part of the step
+     * @return Counts, all zero if counting is off or unavailable
+     */
+    PerfSample perf_counts(PerfPhase phase) const;
+
+    /**
+     * Why hardware counters are unavailable
+     * @return Error message, empty if counting works or was never enabled
+     */
+    const std::string& perf_error() const;
 
 private:
     // Simulation parameters
     int m_height;         // Grid height
     int m_width;        // Grid width
-    float m_dt;         // Time step
-    float m_c;          // Wave speed
-    float m_s;          // Grid spacing
+    int m_stride;       // Row pitch of the padded arrays (m_width + 2)
+    Compute m_dt;       // Time step
+    Compute m_c;        // Wave speed
+    Compute m_s;        // Grid spacing
     int m_screen_width;  // Rendering screen width
     int m_screen_height;  // Rendering screen height
+    double m_time;      // Simulated time
+    uint64_t m_steps;   // Steps run
+
+    // Simulation state, stored with a one-cell ghost border on every side.
+    // Ghost cells hold zero height, velocity and wetness so the stencil can
+    // read neighbours without bounds checks.
+    std::vector<Storage> m_H;  // Height
+    std::vector<Storage> m_V;  // Velocity
+    BitMask m_Wet;             // Wetness (obstacle map), one bit per cell
+    std::vector<Storage> m_porosity;  // Open fraction per cell, empty while every cell is 0 or 1
+    size_t m_porous_cells;            // Cells with a porosity strictly between 0 and 1
+    std::vector<int> m_porous_rows;   // The same per row, while m_porosity is in use
+
+    const Kernels* m_kernels;  // Stencil kernels selected for this CPU
+    BoundaryConditions<Storage> m_boundaries;
+    AbsorbingLayer<Storage> m_layer;
+    uint64_t m_batch_start;    // Steps run before the current batch
+
+    // Per-cell medium (see BasicMediumFields), empty while uniform
+    std::vector<Storage> m_medium_damping;
+    std::vector<Storage> m_medium_speed;
+
+    StepMode m_step_mode;
+    int m_threads;                       // Threads stepping the simulation
+    std::unique_ptr<ThreadPool> m_pool;  // Persistent workers, unused in OpenMP builds
+
+    // Temporal blocking state
+    int m_block_depth;                              // Steps per pass
+    int m_block_tile;                               // Tile edge length
+    std::vector<Storage> m_H_next;                  // Heights written by the current pass
+    std::vector<Storage> m_V_next;                  // Velocities written by the current pass
+    struct TileScratch {
+        std::vector<Storage> cells;  // Heights followed by velocities
+        BitMask wet;
+    };
+    std::vector<TileScratch> m_block_scratch;       // Per-thread tile copies
+
+    // Sparse stepping state
+    int m_sparse_tile;                 // Tile edge length
+    float m_sparse_threshold;          // Velocity below which a tile counts as still
+    std::vector<uint8_t> m_tile_quiet; // Consecutive still steps per tile, saturating at 2
+    std::vector<int> m_tile_list;      // Tiles stepped this substep
+    float m_active_fraction;
+
+    std::vector<SnapshotChannel*> m_snapshot_channels;
+
+    // Wave gauges
+    struct Probe {
+        int x;
+        int y;
+    };
+    std::vector<Probe> m_probes;
+    ProbeRecorder* m_probe_recorder;
+    size_t m_probe_records;            // Substeps of the current batch that have a record reserved
 
-    // Simulation state
-    std::vector<float> m_H;    // Height
-    std::vector<float> m_V;    // Velocity
-    std::vector<float> m_Wet;  // Wetness (obstacle map)
+    // Hardware event counting, one counter group per worker opened on that worker's thread
+    struct PerfWorker {
+        std::unique_ptr<PerfCounters> counters;
+        PerfSample batch_start;
+        PerfSample counts[static_cast<int>(PerfPhase::Count)];
+    };
+    bool m_perf_enabled;
+    std::vector<PerfWorker> m_perf_workers;
+    std::string m_perf_error;
 
-    std::thread m_plot_thread;
+    // Denormal protection
+    bool m_flush_denormals;
+    Compute m_snap_epsilon;            // Velocities smaller in magnitude are stored as zero
 
     // Helper methods
     void initializeArrays();
     int transform_idx(int x, int y) const;
-    float get_height(int x, int y, int x0, int y0) const;
     float get_wet(int x, int y) const;
-    float acceleration(int x, int y, int x0, int y0) const;
+    void setPorosity(int x, int y, float porosity);
+    void wrapPorosity();
+    bool porousRow(int y) const;
+    MaterialMap rasterize(const Scenario& scenario);
+    void paint(const MaterialMap& map);
+    Grid grid();
+    KernelRegion rowBand(int worker, int workers) const;
     float constrain(float value, float min, float max, float newMin, float newMax);
 
     // Simulation update methods
-    void updateVelocities(float damp, float c_squared_over_s_squared);
-    void applyBoundaryConditions();
-    void updateHeights();
-
-    // Visualization methods
-    void plot_waves();
-    SDL_Color calculateColor(float wet, float height);
-    void mapHeightToColor(float height, unsigned char* r, unsigned char* g, unsigned char* b);
+    void updateVelocities(const Grid& grid, const KernelRegion& region, Compute damp, Compute c_squared_over_s_squared,
+                          int substep);
+    void applyBoundaryConditions(const Grid& grid, const KernelRegion& region, int substep);
+    void updateHeights(const Grid& grid, const KernelRegion& region);
+    void prepareBand(const Grid& grid, const KernelRegion& band, Compute damp, Compute c_squared_over_s_squared,
+                     int substep);
+    void stepBand(const Grid& grid, const KernelRegion& band, Compute damp, Compute c_squared_over_s_squared,
+                  bool prepared, int substep);
+    template <typename Job>
+    void parallel(const Job& job);
+    void barrier();
+    KernelRegion tileRegion(int index, int tile_size) const;
+    void advanceBlocked(int substeps, Compute damp, Compute c_squared_over_s_squared);
+    void advanceTile(const KernelRegion& tile, int depth, int first_substep, TileScratch& scratch,
+                     Compute damp, Compute c_squared_over_s_squared);
+    void advanceSparse(int substeps, Compute damp, Compute c_squared_over_s_squared);
+    void collectActiveTiles(int tiles_x, int tiles_y);
+    float maxAbsVelocity(const Grid& grid, const KernelRegion& region) const;
+    void wakeTile(int x, int y);
+    void wakeEdges();
+    void advanceSteps(int substeps, Compute damp, Compute c_squared_over_s_squared);
+    void advanceBands(int substeps, Compute damp, Compute c_squared_over_s_squared);
+    int stepsToNextSnapshot() const;
+    void publishSnapshots();
+    void sampleProbes(const Grid& grid, const KernelRegion& region, int substep);
+    void beginPerfBatch();
+    void endPerfBatch();
 };
 
 #endif // FLUID_H
\ No newline at end of file
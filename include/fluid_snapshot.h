@@ -0,0 +1,84 @@
+#ifndef FLUID_SNAPSHOT_H
+#define FLUID_SNAPSHOT_H
+
+#include <cstdint>
+#include <vector>
+#include "../include/kernels.h"
+#include "../include/bitmask.h"
+
+template <typename Storage> class Fluid;
+
+/**
+ * Read-only copy of a Fluid's height field and obstacle map, taken between
+ * steps so other threads can draw or analyse it while the simulation runs on.
+ * @tparam Storage Element type of the copied heights
+ */
+template <typename Storage = float>
+class FluidSnapshot {
+public:
+    FluidSnapshot() = default;
+
+    /**
+     * Simulated time at which the snapshot was taken
+     * @return Time in seconds
+     */
+    double sim_time() const;
+
+    /**
+     * Steps the simulation had run when the snapshot was taken
+     */
+    uint64_t step_count() const;
+
+    /**
+     * Snapshot width, 0 until the first capture
+     * @return Width in cells
+     */
+    int width() const;
+
+    /**
+     * Snapshot height, 0 until the first capture
+     * @return Height in cells
+     */
+    int height() const;
+
+    /**
+     * Read the height of one cell
+     * @param x X coordinate
+     * @param y Y coordinate
+     * @return Height, converted to double
+     */
+    double height_at(int x, int y) const;
+
+    /**
+     * Check whether a cell holds water rather than an obstacle
+     * @param x X coordinate
+     * @param y Y coordinate
+     * @return True if the cell is wet
+     */
+    bool is_wet(int x, int y) const;
+
+    /**
+     * Convert the heights into packed pixels, see Fluid::map_colors
+     * @param lut Colour lookup table
+     * @param pixels Pixel of cell (0, 0)
+     * @param pitch Row pitch of the pixel buffer in pixels
+     */
+    void map_colors(const ColorLut& lut, uint32_t* pixels, int pitch) const;
+
+private:
+    friend class Fluid<Storage>;
+
+    // Padded exactly like the Fluid arrays so the kernels can read them
+    std::vector<Storage> m_H;
+    BitMask m_Wet;
+    int m_width = 0;
+    int m_height = 0;
+    int m_stride = 0;
+    double m_time = 0.0;
+    uint64_t m_steps = 0;
+    const BasicKernelSet<Storage>* m_kernels = nullptr;
+
+    int transform_idx(int x, int y) const;
+};
+
+#endif // FLUID_SNAPSHOT_H
@@ -0,0 +1,50 @@
+#ifndef FLUID_VIEW_H
+#define FLUID_VIEW_H
+
+#include "../include/renderer.h"
+#include "../include/fluid.h"
+#include "../include/colormap.h"
+
+/**
+ * Draws a Fluid onto the SDL renderer. Kept out of the core library so the
+ * simulation builds and runs without SDL.
+ */
+class FluidView {
+public:
+    /**
+     * Constructor for the FluidView class
+     * @param palette Initial colour scheme
+     */
+    explicit FluidView(Palette palette = Palette::Blue);
+
+    /**
+     * Send a snapshot of the sim to the render buffer as one texture upload
+     * @param snapshot Simulation state to draw
+     * @param renderer Pointer to the renderer
+     */
+    void render(const FluidSnapshot<>& snapshot, Renderer* renderer);
+
+    /**
+     * Draw a snapshot as one filled rectangle per cell, the path used before the
+     * frame texture; kept as the baseline the render benchmark compares against
+     * @param snapshot Simulation state to draw
+     * @param renderer Pointer to the renderer
+     * @param cell_width Rectangle width in pixels
+     * @param cell_height Rectangle height in pixels
+     */
+    void render_rectangles(const FluidSnapshot<>& snapshot, Renderer* renderer, int cell_width, int cell_height) const;
+
+    /**
+     * Switch to the next colour scheme
+     */
+    void cycle_palette();
+
+private:
+    Colormap m_colormap;
+
+    // Size of the renderer's frame texture, 0 until it is created
+    int m_frame_height;
+    int m_frame_width;
+};
+
+#endif // FLUID_VIEW_H
@@ -0,0 +1,111 @@
+#ifndef FRAME_SCHEDULER_H
+#define FRAME_SCHEDULER_H
+
+#include <chrono>
+
+/**
+ * Paces a render loop to a target frame rate. Each frame sleeps only for what
+ * is left of its budget after the work already done, or not at all when vsync
+ * paces presentation. Sleeps end early by the wake-up lateness observed recently,
+ * and only that remainder is spent yielding. Leftover budget can be filled with
+ * extra work, and the achieved frame rate and simulation speed are measured over
+ * half-second windows.
+ */
+class FrameScheduler {
+public:
+    using Clock = std::chrono::steady_clock;
+
+    /**
+     * Constructor for the FrameScheduler class. The first frame starts now.
+     * @param fps Target frames per second, positive
+     */
+    explicit FrameScheduler(int fps);
+
+    /**
+     * Set target frames per second
+     * @param fps Target FPS; exits unless positive
+     */
+    void set_target_fps(int fps);
+
+    /**
+     * Let presentation pace the frames instead of sleeping
+     * @param vsync True if presenting blocks until the display refresh
+     */
+    void set_vsync(bool vsync);
+
+    /**
+     * Time left before the current frame's deadline
+     * @return Seconds, negative once the deadline has passed
+     */
+    double remaining() const;
+
+    /**
+     * Run `work` once, then again for as long as another run is expected to finish
+     * before the frame's deadline. Run time is tracked across frames to predict the
+     * next run; the first run always goes ahead so a slow run cannot starve later frames.
+     * @param work Callable returning false when it had nothing to do
+     * @return Number of runs that did something
+     */
+    template <typename Work>
+    int fill(Work&& work) {
+        int runs = 0;
+        while (runs == 0 || remaining() > m_work_cost) {
+            const Clock::time_point start = Clock::now();
+            if (!work()) {
+                break;
+            }
+            const double cost = std::chrono::duration<double>(Clock::now() - start).count();
+            m_work_cost = m_work_cost == 0.0 ? cost : 0.8 * m_work_cost + 0.2 * cost;
+            runs++;
+        }
+        return runs;
+    }
+
+    /**
+     * Finish the current frame: wait for the rest of its budget and start the next one
+     */
+    void end_frame();
+
+    /**
+     * Report the simulated time reached by the frame, for sim_rate
+     * @param seconds Simulated time in seconds
+     */
+    void record_sim_time(double seconds);
+
+    /**
+     * Frames per second achieved over the last measurement window
+     */
+    double fps() const;
+
+    /**
+     * Fraction of wall-clock time spent in frame work rather than waiting
+     */
+    double busy() const;
+
+    /**
+     * Simulated seconds per wall-clock second over the last measurement window
+     */
+    double sim_rate() const;
+
+private:
+    Clock::duration m_period;
+    bool m_vsync;
+    Clock::time_point m_frame_start;
+    Clock::time_point m_deadline;
+    double m_work_cost;  // Moving average of one fill() run in seconds
+    Clock::duration m_sleep_slack;  // Decaying maximum of how late sleep_until woke
+
+    // Measurement window
+    Clock::time_point m_window_start;
+    int m_window_frames;
+    Clock::duration m_window_work;
+    double m_window_sim_start;
+    double m_sim_time;
+
+    // Results of the last completed window
+    double m_fps;
+    double m_busy;
+    double m_sim_rate;
+};
+
+#endif // FRAME_SCHEDULER_H
@@ -0,0 +1,246 @@
+#ifndef KERNELS_H
+#define KERNELS_H
+
+#include <cstdint>
+#include "../include/precision.h"
+
+/**
+ * View of the padded simulation arrays handed to the stencil kernels.
+ * H and V address interior cell (0, 0); the ghost border guarantees that
+ * every interior cell has all four neighbours addressable. Wet is a packed
+ * bitmask over the whole padded array, so cell (x, y) is bit
+ * (y + 1) * stride + x + 1.
+ */
+template <typename Storage>
+struct BasicFluidGrid {
+    Storage* H;           // Height
+    Storage* V;           // Velocity
+    const uint64_t* Wet;  // Wetness bitmask (obstacle map)
+    int width;         // Interior width of the whole grid
+    int height;        // Interior height of the whole grid
+    int stride;        // Row pitch in cells
+    int x_offset;      // Grid column of the cell the pointers address, non-zero for tile copies
+    int y_offset;      // Grid row of the cell the pointers address, non-zero for tile copies
+};
+
+using FluidGrid = BasicFluidGrid<float>;
+
+/**
+ * Rectangle of interior cells a kernel call works on, end-exclusive
+ */
+struct KernelRegion {
+    int x_begin;
+    int x_end;
+    int y_begin;
+    int y_end;
+};
+
+/**
+ * Per-cell coefficients of the velocity update, for water whose depth or dissipation
+ * varies. damping and speed_squared are dense over the interior, without a ghost
+ * border, and hold factors relative to the uniform coefficients, so they keep their
+ * precision in any storage type and a factor of 1 reproduces the uniform update
+ * exactly. Cell (x, y) of a grid view is entry (y + y_offset) * width + x + x_offset,
+ * which tile copies address correctly too.
+ *
+ * porosity is the open fraction of each cell of porous structures, over the padded
+ * grid: entry (y + y_offset + 1) * stride + x + x_offset + 1. A face between two wet
+ * cells passes the height difference scaled by the smaller porosity of the two, so
+ * porous cells partly transmit and partly reflect. Dry cells are still excluded by
+ * the wet bits.
+ */
+template <typename Storage>
+struct BasicMediumFields {
+    const Storage* damping;        // Per-step velocity factor on top of the uniform damping, or null
+    const Storage* speed_squared;  // Wave speed squared relative to the uniform speed, at most 1; null with damping
+    const Storage* porosity;       // Open fraction per cell, or null where every wet cell is fully open
+    int width;                     // Interior width of the whole grid
+    int stride;                    // Row pitch of porosity, including the ghost border
+};
+
+/**
+ * Auxiliary fields of a perfectly matched layer along the grid edges, stored for
+ * layer cells only. Each row of the arrays starts with a zero, then holds the whole
+ * grid row if full_row says so, otherwise the left layer's cells, another zero and
+ * the right layer's cells. A row of zeros stands in for row -1.
+ *
+ * psi_x of a cell belongs to the face to its right and psi_y to the face below it;
+ * both are kept multiplied by dt so they have the magnitude of a velocity. Damping
+ * profiles are zero outside the layer and grow towards the edges.
+ */
+template <typename Storage>
+struct BasicPmlFields {
+    using Compute = typename ComputeType<Storage>::type;
+
+    const Storage* psi_x;         // Previous step
+    const Storage* psi_y;
+    Storage* next_psi_x;          // Written by this step
+    Storage* next_psi_y;
+    const int64_t* row_start;     // Index of each row's first cell, for rows -1 to height - 1
+    const Storage* sigma_x;       // Damping per column at cell centres, in 1/s
+    const Storage* sigma_x_face;  // Damping per column at the face to the right
+    const Compute* sigma_y;       // Damping per row at cell centres
+    const Compute* sigma_y_face;  // Damping per row at the face below
+    int width;                    // Grid size
+    int height;
+    int left;                     // Layer thickness at each edge in cells
+    int right;
+    int top;
+    int bottom;
+
+    /**
+     * Check whether the fields hold every cell of a row: rows in the top or bottom
+     * layer, and the rows just above them, whose zero entries the layer below reads
+     */
+    bool full_row(const int y) const {
+        return y < top || y >= height - bottom - 1;
+    }
+
+    /**
+     * Index of a layer cell in the field arrays; cells of one row within one layer
+     * are consecutive
+     */
+    int64_t index(const int x, const int y) const {
+        const int64_t start = row_start[y + 1];
+        return full_row(y) || x < left ? start + x : start + x - (width - right - left - 1);
+    }
+};
+
+/**
+ * Colour lookup table in the form the colour-mapping kernel reads it. A wet cell
+ * of height h uses entry clamp((h - offset) * scale, 0, levels - 1), truncated;
+ * dry cells use entry `levels`.
+ */
+struct ColorLut {
+    const uint32_t* colors;  // levels water entries followed by the obstacle entry
+    int levels;
+    float offset;            // Height mapped to the first entry
+    float scale;             // Entries per unit of height
+};
+
+/**
+ * One instruction-set flavour of the wave-equation kernels for a storage type.
+ * All flavours for the same storage type produce bit-identical results; they
+ * differ only in speed. Arithmetic happens in ComputeType<Storage>.
+ */
+template <typename Storage>
+struct BasicKernelSet {
+    using Compute = typename ComputeType<Storage>::type;
+
+    const char* name;
+
+    /**
+     * Semi-implicit velocity update. Lane masks built from the wet bits zero
+     * the contribution of dry neighbours, and dry cells always leave with zero
+     * velocity.
+     * @param grid Simulation arrays
+     * @param region Cells to update
+     * @param damp Per-step velocity damping factor
+     * @param dt Timestep
+     * @param c_squared_over_s_squared Wave speed squared over grid spacing squared
+     * @param snap Velocities smaller than this in magnitude are stored as zero; 0 keeps every value
+     */
+    void (*update_velocities)(const BasicFluidGrid<Storage>& grid, const KernelRegion& region,
+                              Compute damp, Compute dt, Compute c_squared_over_s_squared, Compute snap);
+
+    /**
+     * update_velocities with the damping and wave speed of each cell scaled by its
+     * medium fields and faces weighted by porosity. Gives the same velocities as
+     * update_velocities where every factor is 1.
+     * @param grid Simulation arrays
+     * @param region Cells to update
+     * @param medium Per-cell factors
+     * @param damp Per-step velocity damping factor
+     * @param dt Timestep
+     * @param c_squared_over_s_squared Wave speed squared over grid spacing squared
+     * @param snap Velocities smaller than this in magnitude are stored as zero
+     */
+    void (*update_velocities_medium)(const BasicFluidGrid<Storage>& grid, const KernelRegion& region,
+                                     const BasicMediumFields<Storage>& medium, Compute damp, Compute dt,
+                                     Compute c_squared_over_s_squared, Compute snap);
+
+    /**
+     * Velocity update inside a perfectly matched layer (the second-order form of Grote
+     * and Sim), which also advances the layer's auxiliary fields by one step. Gives the
+     * same velocities as update_velocities where the profiles and fields are zero.
+     * @param grid Simulation arrays, the whole grid
+     * @param region Cells to update; all in the layer and, within middle rows, all on one side
+     * @param pml Layer fields
+     * @param damp Per-step velocity damping factor
+     * @param dt Timestep
+     * @param c_squared_over_s_squared Wave speed squared over grid spacing squared
+     * @param snap Velocities smaller than this in magnitude are stored as zero
+     */
+    void (*update_velocities_pml)(const BasicFluidGrid<Storage>& grid, const KernelRegion& region,
+                                  const BasicPmlFields<Storage>& pml, Compute damp, Compute dt,
+                                  Compute c_squared_over_s_squared, Compute snap);
+
+    /**
+     * Integrate heights from the updated velocities. Relies on dry cells
+     * holding zero velocity, so no mask is read.
+     * @param grid Simulation arrays
+     * @param region Cells to update
+     * @param dt Timestep
+     */
+    void (*update_heights)(const BasicFluidGrid<Storage>& grid, const KernelRegion& region, Compute dt);
+
+    /**
+     * Convert heights into packed pixels through a colour lookup table
+     * @param grid Simulation arrays; only H and Wet are read
+     * @param region Cells to convert
+     * @param lut Colour lookup table
+     * @param pixels Pixel of the region's first cell
+     * @param pitch Row pitch of the pixel buffer in pixels
+     */
+    void (*map_colors)(const BasicFluidGrid<Storage>& grid, const KernelRegion& region, const ColorLut& lut,
+                       uint32_t* pixels, int pitch);
+};
+
+using KernelSet = BasicKernelSet<float>;
+
+namespace kernels {
+    /**
+     * Portable reference implementation, always available
+     */
+    const KernelSet& scalar();
+
+    /**
+     * Instruction-set specific implementations
+     * @return nullptr when not compiled for this target
+     */
+    const KernelSet* sse();
+    const KernelSet* avx2();
+    const KernelSet* avx512();
+
+    /**
+     * Double-precision kernels, left to the compiler to vectorise
+     */
+    const BasicKernelSet<double>& scalar_double();
+
+    /**
+     * Half-precision storage kernels, converting to float on load and back on store
+     * @return nullptr when not compiled for this target
+     */
+    const BasicKernelSet<Half>& scalar_half();
+    const BasicKernelSet<Half>* avx2_half();
+    const BasicKernelSet<Half>* avx512_half();
+
+    /**
+     * Pick the widest kernel set the running CPU supports
+     */
+    template <typename Storage = float>
+    const BasicKernelSet<Storage>& select();
+
+    template <> const BasicKernelSet<float>& select<float>();
+    template <> const BasicKernelSet<double>& select<double>();
+    template <> const BasicKernelSet<Half>& select<Half>();
+
+    /**
+     * Look up a single-precision kernel set by name
+     * @param name "scalar", "sse", "avx2" or "avx512"
+     * @return nullptr if unknown or not usable on this CPU
+     */
+    const KernelSet* find(const char* name);
+}
+
+#endif // KERNELS_H
@@ -0,0 +1,111 @@
+#ifndef PERF_COUNTERS_H
+#define PERF_COUNTERS_H
+
+#include <cstdint>
+#include <string>
+#include <thread>
+
+/**
+ * Hardware events counted by PerfCounters
+ */
+enum class PerfEvent {
+    Cycles,
+    Instructions,
+    L1dReadMisses,
+    LlcMisses,
+    BranchMisses,
+    Count
+};
+
+/**
+ * Event counts, either raw readings or the difference between two
+ */
+struct PerfSample {
+    uint64_t values[static_cast<int>(PerfEvent::Count)] = {};
+
+    uint64_t operator[](const PerfEvent event) const { return values[static_cast<int>(event)]; }
+
+    PerfSample& operator+=(const PerfSample& other) {
+        for (int i = 0; i < static_cast<int>(PerfEvent::Count); i++) {
+            values[i] += other.values[i];
+        }
+        return *this;
+    }
+
+    PerfSample operator-(const PerfSample& other) const {
+        PerfSample difference;
+        for (int i = 0; i < static_cast<int>(PerfEvent::Count); i++) {
+            difference.values[i] = values[i] - other.values[i];
+        }
+        return difference;
+    }
+};
+
+/**
+ * Hardware performance counters of the calling thread, read through Linux
+ * perf_event_open. User-space events only. All events form one group so they are
+ * scheduled together, and counts are scaled up if the kernel had to multiplex them.
+ *
+ * Counters are often unavailable: inside VMs without a virtual PMU, with
+ * kernel.perf_event_paranoid above 2, or on other operating systems. Construction
+ * then still succeeds and available() returns false.
+ */
+class PerfCounters {
+public:
+    /**
+     * Open the counters for the calling thread. They start counting immediately.
+     */
+    PerfCounters();
+
+    /**
+     * Destructor - closes the counters
+     */
+    ~PerfCounters();
+
+    PerfCounters(const PerfCounters&) = delete;
+    PerfCounters& operator=(const PerfCounters&) = delete;
+
+    /**
+     * Check whether the cycle counter, which every other event depends on, could be opened
+     */
+    bool available() const;
+
+    /**
+     * Check whether one event is counted; a CPU may lack some cache events
+     * @param event Event to check
+     */
+    bool has(PerfEvent event) const;
+
+    /**
+     * Why the counters are unavailable
+     * @return Error message, empty when available
+     */
+    const std::string& error() const;
+
+    /**
+     * Thread whose events are counted
+     */
+    std::thread::id thread() const;
+
+    /**
+     * Read every event; subtract two readings to count a stretch of code. Only the
+     * owning thread's events are counted, but any thread may read.
+     * @return Counts since opening, zero for events that are not counted
+     */
+    PerfSample read() const;
+
+    /**
+     * Short name of an event for reports
+     * @param event Event to name
+     */
+    static const char* name(PerfEvent event);
+
+private:
+    int m_fds[static_cast<int>(PerfEvent::Count)];  // -1 for events that could not be opened
+    int m_slots[static_cast<int>(PerfEvent::Count)];  // Position of each event in a group read
+    int m_opened;
+    std::string m_error;
+    std::thread::id m_thread;
+};
+
+#endif // PERF_COUNTERS_H
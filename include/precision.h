@@ -0,0 +1,112 @@
+#ifndef PRECISION_H
+#define PRECISION_H
+
+#include <cstdint>
+#include <cstring>
+#include <type_traits>
+
+/**
+ * IEEE 754 binary16 value, used only for storage. Arithmetic happens in float.
+ */
+struct Half {
+    uint16_t bits;
+};
+
+/**
+ * Convert a float to half precision, rounding to nearest even like the F16C
+ * instructions so software and hardware conversions agree bit for bit
+ */
+inline Half float_to_half(const float value) {
+    constexpr uint32_t f32_infinity = 255u << 23;
+    constexpr uint32_t f16_max = (127u + 16u) << 23;
+    constexpr uint32_t denorm_magic = ((127u - 15u) + (23u - 10u) + 1u) << 23;
+
+    uint32_t f;
+    std::memcpy(&f, &value, sizeof(f));
+    const uint32_t sign = f & 0x80000000u;
+    f ^= sign;
+
+    uint16_t out;
+    if (f >= f16_max) {
+        // Overflow goes to infinity, NaN stays a quiet NaN
+        out = f > f32_infinity ? 0x7e00 : 0x7c00;
+    } else if (f < (113u << 23)) {
+        // Result is subnormal or zero; let the float adder do the rounding
+        float shifted;
+        float magic;
+        std::memcpy(&shifted, &f, sizeof(shifted));
+        std::memcpy(&magic, &denorm_magic, sizeof(magic));
+        shifted += magic;
+        uint32_t rounded;
+        std::memcpy(&rounded, &shifted, sizeof(rounded));
+        out = static_cast<uint16_t>(rounded - denorm_magic);
+    } else {
+        // Rebias the exponent and round the dropped mantissa bits to nearest even
+        const uint32_t mantissa_odd = (f >> 13) & 1u;
+        f += ((15u - 127u) << 23) + 0xfffu;
+        f += mantissa_odd;
+        out = static_cast<uint16_t>(f >> 13);
+    }
+    return Half{static_cast<uint16_t>(out | (sign >> 16))};
+}
+
+/**
+ * Convert a half precision value to float, which is always exact
+ */
+inline float half_to_float(const Half value) {
+    constexpr uint32_t shifted_exponent = 0x7c00u << 13;
+    constexpr uint32_t magic_bits = 113u << 23;
+
+    uint32_t out = (value.bits & 0x7fffu) << 13;
+    const uint32_t exponent = shifted_exponent & out;
+    out += (127u - 15u) << 23;
+
+    if (exponent == shifted_exponent) {
+        // Infinity or NaN
+        out += (128u - 16u) << 23;
+    } else if (exponent == 0) {
+        // Zero or subnormal, renormalised by a float subtraction
+        out += 1u << 23;
+        float f;
+        float magic;
+        std::memcpy(&f, &out, sizeof(f));
+        std::memcpy(&magic, &magic_bits, sizeof(magic));
+        f -= magic;
+        std::memcpy(&out, &f, sizeof(out));
+    }
+    out |= static_cast<uint32_t>(value.bits & 0x8000u) << 16;
+
+    float result;
+    std::memcpy(&result, &out, sizeof(result));
+    return result;
+}
+
+/**
+ * Type a storage type is computed in: itself, except half precision which is
+ * computed in float
+ */
+template <typename Storage>
+struct ComputeType {
+    using type = Storage;
+};
+
+template <>
+struct ComputeType<Half> {
+    using type = float;
+};
+
+/**
+ * Convert between storage and compute types
+ */
+template <typename To, typename From>
+inline To precision_cast(const From value) {
+    if constexpr (std::is_same_v<To, Half>) {
+        return float_to_half(static_cast<float>(value));
+    } else if constexpr (std::is_same_v<From, Half>) {
+        return static_cast<To>(half_to_float(value));
+    } else {
+        return static_cast<To>(value);
+    }
+}
+
+#endif // PRECISION_H
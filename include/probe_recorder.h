@@ -0,0 +1,99 @@
+#ifndef PROBE_RECORDER_H
+#define PROBE_RECORDER_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+/**
+ * Single-producer, single-consumer ring of wave-gauge samples. The simulation
+ * appends one record per substep holding the height (and optionally the
+ * velocity) at every probe; a viewer or file writer drains the records on its
+ * own thread. When the ring is full new records are dropped and counted, so
+ * the simulation never waits. No memory is allocated after construction.
+ */
+class ProbeRecorder {
+public:
+    /**
+     * Constructor for the ProbeRecorder class
+     * @param probes Number of probes per record, must match the probes registered on the Fluid
+     * @param record_velocity Also record the velocity at every probe
+     * @param capacity Number of records in the ring
+     */
+    ProbeRecorder(int probes, bool record_velocity, size_t capacity);
+
+    ProbeRecorder(const ProbeRecorder&) = delete;
+    ProbeRecorder& operator=(const ProbeRecorder&) = delete;
+
+    int probes() const;
+    bool records_velocity() const;
+    size_t capacity() const;
+
+    /**
+     * Producer: make room for the records of a batch of substeps. Substeps that
+     * do not fit are counted as dropped.
+     * @param count Records wanted
+     * @return Records that fit, at most count
+     */
+    size_t reserve(size_t count);
+
+    /**
+     * Producer: heights of a reserved record
+     * @param offset Index of the record within the reservation
+     * @return One value per probe
+     */
+    float* heights(size_t offset);
+
+    /**
+     * Producer: velocities of a reserved record, nullptr unless velocities are recorded
+     * @param offset Index of the record within the reservation
+     * @return One value per probe
+     */
+    float* velocities(size_t offset);
+
+    /**
+     * Producer: publish reserved records
+     * @param count Records filled, at most the number reserve returned
+     * @param first_step Step count after the first of them
+     */
+    void commit(size_t count, uint64_t first_step);
+
+    /**
+     * Consumer: visit every waiting record in order, then release them
+     * @param visit Called as visit(step, heights, velocities); velocities is nullptr
+     *              unless recorded. The pointers are valid only during the call.
+     * @return Number of records visited
+     */
+    template <typename Visit>
+    size_t drain(Visit&& visit) {
+        const uint64_t released = m_released.load(std::memory_order_relaxed);
+        const uint64_t written = m_written.load(std::memory_order_acquire);
+        for (uint64_t record = released; record < written; record++) {
+            const size_t slot = record % m_capacity;
+            const float* values = &m_values[slot * m_record_size];
+            visit(m_steps[slot], values, m_record_velocity ? values + m_probes : nullptr);
+        }
+        m_released.store(written, std::memory_order_release);
+        return static_cast<size_t>(written - released);
+    }
+
+    /**
+     * Records dropped because the ring was full
+     */
+    uint64_t dropped() const;
+
+private:
+    int m_probes;
+    bool m_record_velocity;
+    size_t m_capacity;
+    size_t m_record_size;          // Floats per record
+    std::vector<float> m_values;   // Heights then velocities of each record
+    std::vector<uint64_t> m_steps; // Step count of each record
+
+    alignas(64) std::atomic<uint64_t> m_written;   // Records published, advanced by the producer
+    alignas(64) std::atomic<uint64_t> m_released;  // Records drained, advanced by the consumer
+    alignas(64) std::atomic<uint64_t> m_dropped;
+};
+
+#endif // PROBE_RECORDER_H
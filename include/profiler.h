@@ -0,0 +1,136 @@
+#ifndef PROFILER_H
+#define PROFILER_H
+
+#include <cstdint>
+#include <ostream>
+#include <vector>
+
+#ifdef WAVESIM_PROFILE
+#if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+#include <intrin.h>
+#define WAVESIM_PROFILE_RDTSC
+#elif defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define WAVESIM_PROFILE_RDTSC
+#else
+#include <chrono>
+#endif
+#endif
+
+/**
+ * Scoped-zone profiler. WAVESIM_ZONE("name") times the rest of the enclosing scope
+ * and records it into a ring buffer owned by the calling thread, so recording never
+ * takes a lock. Per-zone call counts and totals are kept next to the ring and can be
+ * read at any time; the rings can be exported as a Chrome trace that Perfetto opens.
+ *
+ * Zones only exist in builds with WAVESIM_PROFILE defined (the WAVESIM_PROFILING
+ * CMake option). Otherwise the macro expands to nothing, zone_stats is empty and
+ * the exported trace has no events.
+ */
+namespace profiler {
+    /**
+     * Accumulated time of every zone with the same name, over all threads
+     */
+    struct ZoneStats {
+        const char* name;
+        uint64_t calls;
+        double total_ms;
+        double max_ms;
+    };
+
+    /**
+     * Whether zones are compiled in
+     */
+    constexpr bool enabled() {
+#ifdef WAVESIM_PROFILE
+        return true;
+#else
+        return false;
+#endif
+    }
+
+    /**
+     * Name the calling thread in exported traces
+     * @param name Thread name; must outlive the profiler, e.g. a string literal
+     */
+    void set_thread_name(const char* name);
+
+    /**
+     * Per-zone counters since the start of the program, sorted by total time.
+     * Safe to call while other threads record.
+     * @return One entry per zone name
+     */
+    std::vector<ZoneStats> zone_stats();
+
+    /**
+     * Print zone_stats as a table
+     * @param out Stream to print to
+     */
+    void print_zone_stats(std::ostream& out);
+
+    /**
+     * Write the zones still held in every thread's ring as Chrome trace JSON. Each
+     * ring keeps the most recent zones of its thread. Safe to call while other
+     * threads record; zones overwritten during the export are left out.
+     * @param out Stream to write to
+     */
+    void write_chrome_trace(std::ostream& out);
+
+#ifdef WAVESIM_PROFILE
+    /**
+     * A WAVESIM_ZONE call site, registered once on first use
+     */
+    class Site {
+    public:
+        explicit Site(const char* name);
+        int id() const { return m_id; }
+
+    private:
+        int m_id;  // -1 once the site table is full; such zones are not recorded
+    };
+
+    /**
+     * Times one pass through a zone
+     */
+    class Zone {
+    public:
+        explicit Zone(const Site& site) : m_site(site.id()), m_start(ticks()) {}
+        ~Zone() { record(m_site, m_start, ticks()); }
+
+        Zone(const Zone&) = delete;
+        Zone& operator=(const Zone&) = delete;
+
+        /**
+         * Timestamp in profiler ticks: the CPU timestamp counter on x86, which is far
+         * cheaper to read than the system clock, and nanoseconds elsewhere
+         */
+        static uint64_t ticks() {
+#ifdef WAVESIM_PROFILE_RDTSC
+            return __rdtsc();
+#else
+            return std::chrono::duration_cast<std::chrono::nanoseconds>(
+                std::chrono::steady_clock::now().time_since_epoch()).count();
+#endif
+        }
+
+    private:
+        int m_site;
+        uint64_t m_start;
+
+        static void record(int site, uint64_t start, uint64_t end);
+    };
+#endif
+}
+
+#define WAVESIM_ZONE_CONCAT_(a, b) a##b
+#define WAVESIM_ZONE_CONCAT(a, b) WAVESIM_ZONE_CONCAT_(a, b)
+
+#ifdef WAVESIM_PROFILE
+#define WAVESIM_ZONE(name)                                                                       \
+    static const profiler::Site WAVESIM_ZONE_CONCAT(wavesim_zone_site_, __LINE__)(name);       \
+    const profiler::Zone WAVESIM_ZONE_CONCAT(wavesim_zone_, __LINE__)(WAVESIM_ZONE_CONCAT(wavesim_zone_site_, __LINE__))
+#else
+#define WAVESIM_ZONE(name) static_cast<void>(0)
+#endif
+
+#endif // PROFILER_H
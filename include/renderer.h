@@ -2,6 +2,7 @@
 #define RENDERER_H
 
 #include "SDL/SDL.h"
+#include "../include/frame_scheduler.h"
 
 class Renderer {
 public:
@@ -37,9 +38,9 @@ public:
     void close();
 
     /**
-     * Present the rendered frame and delay based on FPS
+     * Present the rendered frame and wait for whatever is left of the frame's time budget
      */
-    void draw() const;
+    void draw();
 
     /**
      * Clear the renderer with black background
@@ -56,6 +57,33 @@ public:
      */
     void drawRectangle(int x, int y, int width, int height, SDL_Color color) const;
 
+    /**
+     * Create the streaming frame texture. Each texel is one SDL_Color (RGBA bytes)
+     * and the texture is scaled to fill the window when drawn.
+     * @param width Texture width in pixels
+     * @param height Texture height in pixels
+     * @throws std::runtime_error if the texture cannot be created
+     */
+    void createFrame(int width, int height);
+
+    /**
+     * Lock the frame texture for writing. Every pixel must be written before
+     * unlockFrame, as the previous contents are not preserved.
+     * @param pitch Set to the length of one row in bytes
+     * @return Pointer to the first row
+     */
+    unsigned char* lockFrame(int* pitch);
+
+    /**
+     * Upload the pixels written since lockFrame
+     */
+    void unlockFrame();
+
+    /**
+     * Copy the frame texture to the whole window
+     */
+    void drawFrame() const;
+
     /**
      * Process SDL events, including quit events
      */
@@ -73,16 +101,33 @@ public:
      */
     void setFPS(int fps);
 
+    /**
+     * Let the display refresh pace presentation instead of the frame scheduler.
+     * Must be set before initialize.
+     * @param vsync True to synchronise presentation with the display refresh
+     */
+    void setVSync(bool vsync);
+
+    /**
+     * Frame pacing, for filling spare frame time and reading the achieved rates
+     * @return Scheduler timing the frames presented by draw
+     */
+    FrameScheduler& scheduler();
+
 private:
     // Window properties
     const char* m_title;
     int m_height;
     int m_width;
     int m_fps;
+    bool m_vsync;
 
     // SDL objects
     SDL_Window* m_window;
     SDL_Renderer* m_renderer;
+    SDL_Texture* m_frame;
+
+    FrameScheduler m_scheduler;
 
     // State
     bool m_running;
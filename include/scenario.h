@@ -0,0 +1,171 @@
+#ifndef SCENARIO_H
+#define SCENARIO_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+/**
+ * What a structure or zone is made of
+ */
+struct Material {
+    float porosity;      // Open fraction: 0 for solid obstacles, 1 for water
+    float speed;         // Wave speed as a fraction of the uniform speed c
+    float damping_rate;  // Extra decay rate in 1/s
+
+    bool operator==(const Material&) const = default;
+};
+
+/**
+ * Rasterized scenario: every row is a list of runs of one material each, left to
+ * right, that together cover the row. Material 0 marks cells no shape covers.
+ */
+struct MaterialMap {
+    struct Run {
+        int32_t end;        // Column after the run's last cell
+        uint32_t material;  // Index into materials
+    };
+
+    int width = 0;
+    int height = 0;
+    std::vector<Material> materials;
+    std::vector<std::vector<Run>> rows;
+
+    /**
+     * Write the map to a file, replacing it atomically
+     * @param path File to write
+     * @param key Content hash the map belongs to, see Scenario::hash
+     * @return False if the file could not be written
+     */
+    bool save(const std::string& path, uint64_t key) const;
+
+    /**
+     * Read a map written by save
+     * @param path File to read
+     * @param key Content hash the map must belong to
+     * @return False if the file is missing, damaged or belongs to another key; the map is then unchanged
+     */
+    bool load(const std::string& path, uint64_t key);
+};
+
+/**
+ * Obstacles, porous structures and bathymetry of a scene, as shapes painted in
+ * order so later shapes cover earlier ones. Shapes are rasterized one row at a
+ * time by scanline: a cell belongs to a shape when its centre does.
+ *
+ * Text format, one statement per line, '#' starts a comment:
+ *
+ *     grid W H                           coordinate frame, scaled to the simulated grid;
+ *                                        without it coordinates are cells
+ *     polygon X Y X Y X Y ... [ATTR]...  even-odd fill
+ *     circle X Y RADIUS [ATTR]...
+ *     breakwater X Y X Y WIDTH [ATTR]... straight wall of the given width
+ *
+ * Attributes: porosity P (0 solid to 1 water), speed S (fraction of c, at most 1),
+ * depth D (fraction of the reference depth, giving speed sqrt(D)) and damping R
+ * (extra decay rate in 1/s). A shape without attributes is a solid obstacle; one
+ * with only speed, depth or damping is water.
+ */
+class Scenario {
+public:
+    struct Point {
+        double x;
+        double y;
+    };
+
+    /**
+     * Constructor - an empty scene in grid cells
+     */
+    Scenario();
+
+    /**
+     * Parse the text format; exits with the line of the first error
+     * @param text Scenario text
+     * @param source Name used in error messages
+     */
+    static Scenario parse(const std::string& text, const std::string& source);
+
+    /**
+     * Read and parse a scenario file; exits if it cannot be read or parsed
+     * @param path File to read
+     */
+    static Scenario load(const std::string& path);
+
+    /**
+     * Sierpinski carpet of square holes, built without recursion
+     * @param x X coordinate of the carpet's top left cell
+     * @param y Y coordinate of the carpet's top left cell
+     * @param size Edge length in cells
+     * @param level Depth of the carpet; level L holds (8^L - 1) / 7 squares
+     * @param porosity Open fraction of the squares
+     */
+    static Scenario sierpinski_carpet(int x, int y, int size, int level, float porosity);
+
+    /**
+     * Set the coordinate frame that is scaled to the simulated grid
+     * @param width Frame width, 0 to use grid cells
+     * @param height Frame height, 0 to use grid cells
+     */
+    void set_frame(double width, double height);
+
+    void add_polygon(const std::vector<Point>& points, const Material& material);
+    void add_circle(Point centre, double radius, const Material& material);
+    void add_breakwater(Point from, Point to, double width, const Material& material);
+
+    /**
+     * Number of shapes
+     */
+    size_t shapes() const;
+
+    /**
+     * Content hash of the scene rasterized onto a grid; identical scenes and grids
+     * give identical keys however they were written
+     * @param width Grid width
+     * @param height Grid height
+     */
+    uint64_t hash(int width, int height) const;
+
+    /**
+     * Start a map of this scene for a grid, with no rows rasterized yet
+     * @param width Grid width
+     * @param height Grid height
+     */
+    MaterialMap map(int width, int height) const;
+
+    /**
+     * Rasterize a band of rows. Rows are independent, so bands may be rasterized
+     * concurrently into the same map. The cost grows with the shapes and material
+     * changes along a row, not with its width.
+     * @param map Map from map()
+     * @param y_begin First row
+     * @param y_end Row after the last
+     */
+    void rasterize(MaterialMap& map, int y_begin, int y_end) const;
+
+private:
+    enum class ShapeKind {
+        Polygon,
+        Circle
+    };
+    struct Shape {
+        ShapeKind kind;
+        uint32_t material;
+        size_t first_point;  // Polygons: points[first_point, first_point + point_count)
+        size_t point_count;
+        Point centre;        // Circles
+        double radius;
+        double y_min;        // Bounding rows in frame coordinates
+        double y_max;
+    };
+
+    double m_frame_width;
+    double m_frame_height;
+    std::vector<Material> m_materials;  // Entry 0 is the unpainted placeholder
+    std::vector<Point> m_points;
+    std::vector<Shape> m_shapes;
+
+    uint32_t materialIndex(const Material& material);
+    void addShape(Shape shape);
+};
+
+#endif // SCENARIO_H
@@ -0,0 +1,100 @@
+#ifndef SIMULATION_THREAD_H
+#define SIMULATION_THREAD_H
+
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "../include/fluid.h"
+#include "../include/triple_buffer.h"
+
+/**
+ * Steps a Fluid on a thread of its own and publishes a snapshot after every
+ * batch of steps through a triple buffer. The display thread reads the newest
+ * snapshot whenever it draws, so neither side waits for the other and the
+ * simulation rate does not depend on the display refresh.
+ */
+class SimulationThread {
+public:
+    /**
+     * Constructor for the SimulationThread class
+     * @param fluid Simulation to step. Only the simulation thread may touch it while running.
+     * @param halflife Decay time for waves
+     */
+    SimulationThread(Fluid<>& fluid, float halflife);
+
+    /**
+     * Destructor - stops the simulation thread
+     */
+    ~SimulationThread();
+
+    SimulationThread(const SimulationThread&) = delete;
+    SimulationThread& operator=(const SimulationThread&) = delete;
+
+    /**
+     * Start stepping on the simulation thread
+     */
+    void start();
+
+    /**
+     * Stop stepping and join the simulation thread
+     */
+    void stop();
+
+    /**
+     * Run one batch of steps on the calling thread and publish its snapshot, for
+     * stepping inline between frames instead of calling start
+     * @return False if real-time mode is ahead of the clock and nothing was stepped
+     */
+    bool pump();
+
+    /**
+     * Queue a splash, applied by the simulation thread before its next batch
+     * @param x X coordinate on screen
+     * @param y Y coordinate on screen
+     */
+    void add_velocity(int x, int y);
+
+    /**
+     * Choose between stepping as fast as possible and keeping simulated time in
+     * step with wall-clock time
+     * @param realtime True to follow wall-clock time
+     */
+    void set_realtime(bool realtime);
+
+    /**
+     * Whether simulated time follows wall-clock time
+     */
+    bool realtime() const;
+
+    /**
+     * Newest published snapshot. Never blocks; call from a single consumer thread.
+     * @return Snapshot, or nullptr before the first batch has finished
+     */
+    const FluidSnapshot<>* latest();
+
+private:
+    Fluid<>& m_fluid;
+    float m_halflife;
+
+    std::thread m_thread;
+    std::atomic<bool> m_running;
+    std::atomic<bool> m_realtime;
+
+    // Splashes queued by other threads
+    std::mutex m_input_mutex;
+    std::vector<std::pair<int, int>> m_splashes;
+    std::vector<std::pair<int, int>> m_applying;  // Simulation thread's copy of the queue
+
+    TripleBuffer<FluidSnapshot<>> m_snapshots;
+
+    // Real-time pacing
+    double m_lag;                                 // Wall-clock seconds not simulated yet
+    std::chrono::steady_clock::time_point m_last;  // When the previous batch started
+
+    void run();
+    void applyInput();
+};
+
+#endif // SIMULATION_THREAD_H
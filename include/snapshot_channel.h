@@ -0,0 +1,101 @@
+#ifndef SNAPSHOT_CHANNEL_H
+#define SNAPSHOT_CHANNEL_H
+
+#include <atomic>
+#include <cstdint>
+#include <vector>
+
+/**
+ * One downsampled copy of the height field
+ */
+struct SnapshotFrame {
+    std::vector<float> heights;  // Row-major, width x height of the channel
+    double time = 0.0;           // Simulated time of the copy
+    uint64_t step = 0;           // Step count of the copy
+};
+
+/**
+ * Single-producer, single-consumer channel of downsampled height snapshots.
+ * The simulation writes a frame into a preallocated ring every `cadence`
+ * steps; a consumer thread such as a plotter or a file writer reads the frames
+ * at its own pace. Neither side blocks: when the ring is full the producer
+ * drops the new frame. No memory is allocated after construction.
+ */
+class SnapshotChannel {
+public:
+    /**
+     * Constructor for the SnapshotChannel class
+     * @param source_width Width of the simulation grid in cells
+     * @param source_height Height of the simulation grid in cells
+     * @param downsample Edge length of the cell blocks averaged into one value
+     * @param capacity Number of frames in the ring
+     * @param cadence Steps between frames
+     */
+    SnapshotChannel(int source_width, int source_height, int downsample, int capacity, int cadence);
+
+    SnapshotChannel(const SnapshotChannel&) = delete;
+    SnapshotChannel& operator=(const SnapshotChannel&) = delete;
+
+    int source_width() const;
+    int source_height() const;
+    int downsample() const;
+    int cadence() const;
+
+    /**
+     * Frame width, source width divided by the downsample factor and rounded up
+     */
+    int width() const;
+
+    /**
+     * Frame height, source height divided by the downsample factor and rounded up
+     */
+    int height() const;
+
+    /**
+     * Producer: claim the next free frame
+     * @return Frame to fill, or nullptr if the consumer has fallen a full ring behind
+     */
+    SnapshotFrame* begin_write();
+
+    /**
+     * Producer: hand the frame from begin_write to the consumer
+     */
+    void end_write();
+
+    /**
+     * Consumer: oldest frame not yet released
+     * @return Frame, or nullptr if none is waiting
+     */
+    const SnapshotFrame* read();
+
+    /**
+     * Consumer: newest frame, releasing every older one
+     * @return Frame, or nullptr if none is waiting
+     */
+    const SnapshotFrame* read_latest();
+
+    /**
+     * Consumer: give the frame from read or read_latest back to the producer
+     */
+    void release();
+
+    /**
+     * Frames dropped because the ring was full
+     */
+    uint64_t dropped() const;
+
+private:
+    int m_source_width;
+    int m_source_height;
+    int m_downsample;
+    int m_cadence;
+    int m_width;
+    int m_height;
+    std::vector<SnapshotFrame> m_frames;
+
+    alignas(64) std::atomic<uint64_t> m_written;   // Frames published, advanced by the producer
+    alignas(64) std::atomic<uint64_t> m_released;  // Frames released, advanced by the consumer
+    alignas(64) std::atomic<uint64_t> m_dropped;
+};
+
+#endif // SNAPSHOT_CHANNEL_H
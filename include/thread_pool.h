@@ -0,0 +1,64 @@
+#ifndef THREAD_POOL_H
+#define THREAD_POOL_H
+
+#include <barrier>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+class ThreadPool {
+public:
+    /**
+     * Constructor for the ThreadPool class. Worker threads are started once and
+     * sleep between jobs.
+     * @param threads Number of threads taking part in a job, including the caller
+     */
+    explicit ThreadPool(int threads);
+
+    /**
+     * Destructor - stops and joins the worker threads
+     */
+    ~ThreadPool();
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    /**
+     * Number of threads taking part in a job
+     */
+    int size() const;
+
+    /**
+     * Run a job on every thread of the pool and wait for all of them to finish.
+     * The calling thread takes part as worker 0.
+     * @param job Callable receiving the worker index
+     */
+    void run(const std::function<void(int)>& job);
+
+    /**
+     * Block until every thread of the running job has reached this point.
+     * Must be called by all workers the same number of times.
+     */
+    void barrier();
+
+private:
+    int m_size;
+    std::vector<std::thread> m_workers;
+
+    std::mutex m_mutex;
+    std::condition_variable m_start;
+    std::condition_variable m_done;
+    const std::function<void(int)>* m_job;
+    uint64_t m_generation;  // Incremented for every job so workers never run one twice
+    int m_pending;          // Workers still running the current job
+    bool m_stopping;
+
+    std::barrier<> m_barrier;
+
+    void workerLoop(int index);
+};
+
+#endif // THREAD_POOL_H
@@ -0,0 +1,67 @@
+#ifndef TRIPLE_BUFFER_H
+#define TRIPLE_BUFFER_H
+
+#include <atomic>
+#include <cstdint>
+
+/**
+ * Lock-free triple buffer handing the newest value from one producer thread to
+ * one consumer thread. The producer fills back() and publishes it; the consumer
+ * picks up whatever was published last. Neither side ever waits for the other,
+ * and values published while the consumer was busy are skipped.
+ * @tparam T Slot type, reused between publishes to avoid reallocation
+ */
+template <typename T>
+class TripleBuffer {
+public:
+    TripleBuffer() : m_back(0), m_middle(1), m_front(2) {}
+
+    TripleBuffer(const TripleBuffer&) = delete;
+    TripleBuffer& operator=(const TripleBuffer&) = delete;
+
+    /**
+     * Slot the producer writes. Only the producer thread may touch it.
+     */
+    T& back() {
+        return m_slots[m_back];
+    }
+
+    /**
+     * Hand the back slot to the consumer and take over an unused one
+     */
+    void publish() {
+        m_back = m_middle.exchange(static_cast<uint8_t>(m_back | fresh), std::memory_order_acq_rel) & index_mask;
+    }
+
+    /**
+     * Move the newest published value to the front slot
+     * @return True if a value newer than the current front was published
+     */
+    bool update() {
+        if ((m_middle.load(std::memory_order_relaxed) & fresh) == 0) {
+            return false;
+        }
+        m_front = m_middle.exchange(m_front, std::memory_order_acq_rel) & index_mask;
+        return true;
+    }
+
+    /**
+     * Slot the consumer reads. Only the consumer thread may touch it.
+     */
+    const T& front() const {
+        return m_slots[m_front];
+    }
+
+private:
+    static constexpr uint8_t index_mask = 0x3;
+    static constexpr uint8_t fresh = 0x4;  // Set in m_middle while it holds an unread value
+
+    T m_slots[3];
+
+    // Each side's index on its own cache line, away from the shared one
+    alignas(64) uint8_t m_back;
+    alignas(64) std::atomic<uint8_t> m_middle;
+    alignas(64) uint8_t m_front;
+};
+
+#endif // TRIPLE_BUFFER_H
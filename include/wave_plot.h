@@ -0,0 +1,25 @@
+#ifndef WAVE_PLOT_H
+#define WAVE_PLOT_H
+
+#include <atomic>
+#include "../include/snapshot_channel.h"
+#include "../include/probe_recorder.h"
+
+/**
+ * Plot the height field with matplotlib until `running` turns false. Frames
+ * come from a snapshot channel, so the simulation is never read directly.
+ * @param channel Channel the simulation publishes into
+ * @param running Cleared by the caller to stop plotting
+ */
+void plot_waves(SnapshotChannel& channel, const std::atomic<bool>& running);
+
+/**
+ * Plot the recent height history at every probe with matplotlib until
+ * `running` turns false
+ * @param recorder Recorder the simulation fills
+ * @param dt Simulation timestep, to label the time axis
+ * @param running Cleared by the caller to stop plotting
+ */
+void plot_gauges(ProbeRecorder& recorder, double dt, const std::atomic<bool>& running);
+
+#endif // WAVE_PLOT_H
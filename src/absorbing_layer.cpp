@@ -0,0 +1,114 @@
+#include "../include/absorbing_layer.h"
+
+#include <cmath>
+#include <iostream>
+
+template <typename Storage>
+AbsorbingLayer<Storage>::AbsorbingLayer(const int width, const int height)
+    : m_width(width), m_height(height), m_left(0), m_right(0), m_top(0), m_bottom(0), m_sigma_max{}
+{
+}
+
+template <typename Storage>
+void AbsorbingLayer<Storage>::set(const Edge edge, const int thickness, const float reflection, const Compute speed) {
+    if (thickness < 0 || !(reflection > 0.0f && reflection < 1.0f)) {
+        std::cerr << "Absorbing layer needs a thickness of at least 0 and a reflection between 0 and 1" << std::endl;
+        exit(1);
+    }
+
+    int* sides[] = {&m_left, &m_right, &m_top, &m_bottom};
+    const int previous = *sides[static_cast<int>(edge)];
+    *sides[static_cast<int>(edge)] = thickness;
+    if (m_left + m_right >= m_width || m_top + m_bottom >= m_height) {
+        *sides[static_cast<int>(edge)] = previous;
+        std::cerr << "Absorbing layers leave no water inside them" << std::endl;
+        exit(1);
+    }
+
+    // R = exp(-2 / c * integral of sigma over the layer), with sigma = max * (depth / thickness)^2
+    m_sigma_max[static_cast<int>(edge)] =
+        thickness > 0 ? static_cast<float>(3.0 * speed * std::log(1.0 / reflection) / (2.0 * thickness)) : 0.0f;
+    rebuild();
+}
+
+template <typename Storage>
+int AbsorbingLayer<Storage>::thickness(const Edge edge) const {
+    const int sides[] = {m_left, m_right, m_top, m_bottom};
+    return sides[static_cast<int>(edge)];
+}
+
+template <typename Storage>
+bool AbsorbingLayer<Storage>::active() const {
+    return m_left + m_right + m_top + m_bottom > 0;
+}
+
+template <typename Storage>
+bool AbsorbingLayer<Storage>::overlaps(const KernelRegion& region) const {
+    return active() && (region.x_begin < m_left || region.x_end > m_width - m_right ||
+                        region.y_begin < m_top || region.y_end > m_height - m_bottom);
+}
+
+template <typename Storage>
+float AbsorbingLayer<Storage>::profile(const float position, const int inner_end, const int outer_begin,
+                                       const int before, const int after, const float sigma_before,
+                                       const float sigma_after) {
+    // Depth below the face between the last inside cell and the first layer cell
+    if (before > 0 && position < inner_end - 0.5f) {
+        const float depth = (inner_end - 0.5f - position) / before;
+        return sigma_before * depth * depth;
+    }
+    if (after > 0 && position > outer_begin - 0.5f) {
+        const float depth = (position - (outer_begin - 0.5f)) / after;
+        return sigma_after * depth * depth;
+    }
+    return 0.0f;
+}
+
+template <typename Storage>
+void AbsorbingLayer<Storage>::rebuild() {
+    const float* sigma = m_sigma_max;
+    const int left = static_cast<int>(Edge::Left);
+    const int right = static_cast<int>(Edge::Right);
+    const int top = static_cast<int>(Edge::Top);
+    const int bottom = static_cast<int>(Edge::Bottom);
+
+    m_sigma_x.resize(m_width);
+    m_sigma_x_face.resize(m_width);
+    for (int x = 0; x < m_width; x++) {
+        m_sigma_x[x] = precision_cast<Storage>(
+            profile(x, m_left, m_width - m_right, m_left, m_right, sigma[left], sigma[right]));
+        m_sigma_x_face[x] = precision_cast<Storage>(
+            profile(x + 0.5f, m_left, m_width - m_right, m_left, m_right, sigma[left], sigma[right]));
+    }
+    m_sigma_y.resize(m_height);
+    m_sigma_y_face.resize(m_height);
+    for (int y = 0; y < m_height; y++) {
+        m_sigma_y[y] = profile(y, m_top, m_height - m_bottom, m_top, m_bottom, sigma[top], sigma[bottom]);
+        m_sigma_y_face[y] = profile(y + 0.5f, m_top, m_height - m_bottom, m_top, m_bottom, sigma[top], sigma[bottom]);
+    }
+
+    // Rows that are not whole (see BasicPmlFields::full_row) hold both side layers
+    m_row_start.resize(m_height + 1);
+    int64_t next = 1;
+    for (int y = -1; y < m_height; y++) {
+        m_row_start[y + 1] = next;
+        const bool whole = y < m_top || y >= m_height - m_bottom - 1;
+        next += (whole ? m_width : m_left + 1 + m_right) + 1;
+    }
+    for (int i = 0; i < 2; i++) {
+        m_psi_x[i].assign(active() ? next : 0, Storage{});
+        m_psi_y[i].assign(active() ? next : 0, Storage{});
+    }
+}
+
+template <typename Storage>
+typename AbsorbingLayer<Storage>::Fields AbsorbingLayer<Storage>::fields(const uint64_t step) {
+    const int read = static_cast<int>(step & 1);
+    return {m_psi_x[read].data(), m_psi_y[read].data(), m_psi_x[1 - read].data(), m_psi_y[1 - read].data(),
+            m_row_start.data(), m_sigma_x.data(), m_sigma_x_face.data(), m_sigma_y.data(), m_sigma_y_face.data(),
+            m_width, m_height, m_left, m_right, m_top, m_bottom};
+}
+
+template class AbsorbingLayer<float>;
+template class AbsorbingLayer<double>;
+template class AbsorbingLayer<Half>;
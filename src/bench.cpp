@@ -0,0 +1,580 @@
+// Benchmark suite: times the solver, and the render paths when built with SDL2, in
+// isolation and writes the results as JSON. Usage:
+//   wavesim_bench [--sizes N,...] [--threads T,...] [--kernels NAME,...]
+//                 [--obstacles empty|sierpinskiL,...] [--mode three-pass|fused|blocked|sparse]
+//                 [--min-time SECONDS] [--out FILE] [--baseline FILE] [--tolerance FRACTION]
+//                 [--skip-solver] [--skip-denormals] [--skip-render] [--perf]
+//
+// Grids are square, N x N cells. Kernel names are the single-precision sets (scalar,
+// sse, avx2, avx512) plus double and half, which use the widest set for that storage
+// type. Bandwidth is the compulsory traffic of a step (heights and velocities read and
+// written once, plus the wet bits) and is also given as a fraction of a STREAM triad
+// measured at start-up; grids that fit in cache can exceed 1.
+//
+// --baseline compares cells per second with an earlier --out file and exits with
+// status 1 if any configuration got slower by more than the tolerance (default 0.05).
+//
+// --perf adds hardware counters (Linux perf_event_open) to every solver result: cycles
+// and IPC, and L1D, LLC and branch misses per cell update, counted over the timed batches.
+//
+// The denormal benchmark steps a wave field whose amplitude has decayed into the
+// subnormal range, as a long damped run can leave behind, without protection, with
+// flush-to-zero, and with velocities snapped to zero below an epsilon.
+
+#include "../include/fluid.h"
+#include "../include/kernels.h"
+
+#ifdef WAVESIM_BENCH_RENDER
+#include "../include/renderer.h"
+#include "../include/fluid_view.h"
+#endif
+
+#include <algorithm>
+#include <cctype>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+struct BenchConfig {
+    std::vector<int> sizes = {128, 512, 2048, 8192};
+    std::vector<int> threads = {1, 0};
+    std::vector<std::string> kernels = {"scalar", "sse", "avx2", "avx512", "double", "half"};
+    std::vector<std::string> obstacles = {"empty", "sierpinski1", "sierpinski2", "sierpinski3",
+                                          "sierpinski4", "sierpinski5"};
+    StepMode mode = StepMode::Fused;
+    const char* mode_name = "fused";
+    double min_time = 0.2;
+    const char* out_path = "wavesim_bench.json";
+    const char* baseline_path = nullptr;
+    double tolerance = 0.05;
+    bool solver = true;
+    bool denormals = true;
+    bool render = true;
+    bool perf = false;
+};
+
+struct BenchResult {
+    std::string name;
+    std::string json;  // Fields other than the name
+    double cells_per_second;
+};
+
+static void usage(const char* program) {
+    std::fprintf(stderr,
+                 "usage: %s [--sizes N,...] [--threads T,...] [--kernels NAME,...]\n"
+                 "          [--obstacles empty|sierpinskiL,...] [--mode three-pass|fused|blocked|sparse]\n"
+                 "          [--min-time SECONDS] [--out FILE] [--baseline FILE] [--tolerance FRACTION]\n"
+                 "          [--skip-solver] [--skip-denormals] [--skip-render] [--perf]\n",
+                 program);
+    exit(1);
+}
+
+static std::vector<std::string> splitList(const char* value) {
+    std::vector<std::string> items;
+    std::stringstream stream(value);
+    std::string item;
+    while (std::getline(stream, item, ',')) {
+        if (!item.empty()) {
+            items.push_back(item);
+        }
+    }
+    return items;
+}
+
+static std::vector<int> parseIntList(const char* program, const char* value) {
+    std::vector<int> numbers;
+    for (const std::string& item : splitList(value)) {
+        char* end = nullptr;
+        const long number = std::strtol(item.c_str(), &end, 10);
+        if (*end != '\0' || number < 0) {
+            usage(program);
+        }
+        numbers.push_back(static_cast<int>(number));
+    }
+    return numbers;
+}
+
+// Level of a "sierpinskiL" obstacle name, or 0 unless L is a positive integer
+static int carpetLevel(const std::string& obstacles) {
+    constexpr const char* prefix = "sierpinski";
+    if (obstacles.rfind(prefix, 0) != 0) {
+        return 0;
+    }
+    const char* digits = obstacles.c_str() + std::strlen(prefix);
+    char* end = nullptr;
+    const long level = std::strtol(digits, &end, 10);
+    if (end == digits || *end != '\0' || !std::isdigit(static_cast<unsigned char>(*digits)) || level <= 0 ||
+        level > 99) {
+        return 0;
+    }
+    return static_cast<int>(level);
+}
+
+static BenchConfig parseArgs(const int argc, char* argv[]) {
+    BenchConfig config;
+    for (int i = 1; i < argc; i++) {
+        const char* option = argv[i];
+        if (std::strcmp(option, "--skip-solver") == 0) {
+            config.solver = false;
+            continue;
+        }
+        if (std::strcmp(option, "--skip-denormals") == 0) {
+            config.denormals = false;
+            continue;
+        }
+        if (std::strcmp(option, "--skip-render") == 0) {
+            config.render = false;
+            continue;
+        }
+        if (std::strcmp(option, "--perf") == 0) {
+            config.perf = true;
+            continue;
+        }
+        if (i + 1 >= argc) {
+            usage(argv[0]);
+        }
+        const char* value = argv[++i];
+        if (std::strcmp(option, "--sizes") == 0) {
+            config.sizes = parseIntList(argv[0], value);
+        } else if (std::strcmp(option, "--threads") == 0) {
+            config.threads = parseIntList(argv[0], value);
+        } else if (std::strcmp(option, "--kernels") == 0) {
+            config.kernels = splitList(value);
+        } else if (std::strcmp(option, "--obstacles") == 0) {
+            config.obstacles = splitList(value);
+        } else if (std::strcmp(option, "--mode") == 0) {
+            config.mode_name = value;
+            if (std::strcmp(value, "three-pass") == 0) config.mode = StepMode::ThreePass;
+            else if (std::strcmp(value, "fused") == 0) config.mode = StepMode::Fused;
+            else if (std::strcmp(value, "blocked") == 0) config.mode = StepMode::TemporalBlocked;
+            else if (std::strcmp(value, "sparse") == 0) config.mode = StepMode::Sparse;
+            else usage(argv[0]);
+        } else if (std::strcmp(option, "--min-time") == 0) {
+            config.min_time = std::atof(value);
+        } else if (std::strcmp(option, "--out") == 0) {
+            config.out_path = value;
+        } else if (std::strcmp(option, "--baseline") == 0) {
+            config.baseline_path = value;
+        } else if (std::strcmp(option, "--tolerance") == 0) {
+            config.tolerance = std::atof(value);
+        } else {
+            usage(argv[0]);
+        }
+    }
+    if (config.min_time <= 0.0 || config.tolerance < 0.0) {
+        usage(argv[0]);
+    }
+    for (const int size : config.sizes) {
+        if (size < 3) {
+            usage(argv[0]);
+        }
+    }
+    for (const std::string& obstacles : config.obstacles) {
+        if (obstacles != "empty" && carpetLevel(obstacles) == 0) {
+            usage(argv[0]);
+        }
+    }
+    return config;
+}
+
+// Thread counts with 0 replaced by every hardware thread, without duplicates
+static std::vector<int> threadCounts(const std::vector<int>& requested) {
+    const int hardware = static_cast<int>(std::max(1u, std::thread::hardware_concurrency()));
+    std::vector<int> counts;
+    for (const int threads : requested) {
+        const int count = threads == 0 ? hardware : threads;
+        if (std::find(counts.begin(), counts.end(), count) == counts.end()) {
+            counts.push_back(count);
+        }
+    }
+    return counts;
+}
+
+// STREAM triad a[i] = b[i] + s * c[i] over arrays far larger than the last-level cache
+static double streamTriad(const int threads) {
+    constexpr size_t elements = size_t(1) << 24;
+    constexpr int repetitions = 5;
+    std::vector<double> a(elements, 0.0);
+    std::vector<double> b(elements, 1.0);
+    std::vector<double> c(elements, 2.0);
+
+    double best = 0.0;
+    for (int r = 0; r < repetitions; r++) {
+        const auto start = std::chrono::steady_clock::now();
+        std::vector<std::thread> workers;
+        for (int t = 0; t < threads; t++) {
+            workers.emplace_back([&, t] {
+                const size_t begin = elements * t / threads;
+                const size_t end = elements * (t + 1) / threads;
+                for (size_t i = begin; i < end; i++) {
+                    a[i] = b[i] + 3.0 * c[i];
+                }
+            });
+        }
+        for (std::thread& worker : workers) {
+            worker.join();
+        }
+        const double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        best = std::max(best, 3.0 * sizeof(double) * elements / seconds * 1e-9);
+    }
+    return best;
+}
+
+template <typename Storage>
+static void placeObstacles(Fluid<Storage>& fluid, const std::string& obstacles) {
+    fluid.clear_obstacles();
+    if (obstacles == "empty") {
+        return;
+    }
+    // Same placement as the default scenario: centred, 95% of the grid height
+    const int level = carpetLevel(obstacles);
+    const int size = fluid.height() * 0.95;
+    fluid.generate_sierpinski_carpet(fluid.width() / 2 - size / 2, fluid.height() / 2 - size / 2, size, level);
+}
+
+// Median seconds per step over a few timed batches sized to fill min_time
+// @param steps Set to the number of timed steps
+template <typename Storage>
+static double timeSteps(Fluid<Storage>& fluid, const double min_time, const bool perf, int* steps) {
+    constexpr int repetitions = 5;
+    constexpr float halflife = 0.7f;
+
+    // Warm up and estimate the cost of one step
+    const double cells = static_cast<double>(fluid.width()) * fluid.height();
+    int batch = std::max(1, static_cast<int>(1e7 / cells));
+    auto start = std::chrono::steady_clock::now();
+    fluid.advance(batch, halflife);
+    const double estimate = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count() / batch;
+    batch = std::max(1, static_cast<int>(min_time / repetitions / estimate));
+    *steps = batch * repetitions;
+
+    // Count events over the timed batches only
+    if (perf) {
+        fluid.set_perf_counters(true);
+    }
+
+    std::vector<double> samples;
+    for (int r = 0; r < repetitions; r++) {
+        start = std::chrono::steady_clock::now();
+        fluid.advance(batch, halflife);
+        samples.push_back(std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count() / batch);
+    }
+    std::sort(samples.begin(), samples.end());
+    return samples[repetitions / 2];
+}
+
+template <typename Storage>
+static void benchSolver(const BenchConfig& config, const std::string& kernel_name, const BasicKernelSet<Storage>& kernels,
+                        const int size, const int threads, const double stream_gbps, std::vector<BenchResult>& results) {
+    // Same physical parameters as the default scenario, one screen pixel per cell
+    Fluid<Storage> fluid(size, size, 1.0f / 48000.0f, 2.0f, 0.001f, size, size);
+    fluid.set_kernels(kernels);
+    fluid.set_threads(threads);
+    fluid.set_step_mode(config.mode);
+
+    // Compulsory traffic of one cell update
+    const double bytes_per_cell = 4.0 * sizeof(Storage) + 1.0 / 8.0;
+
+    for (const std::string& obstacles : config.obstacles) {
+        placeObstacles(fluid, obstacles);
+        fluid.add_velocity(size / 10, size / 2);
+        fluid.add_velocity(size - size / 10, size / 3);
+
+        int steps = 0;
+        const double seconds = timeSteps(fluid, config.min_time, config.perf, &steps);
+        const double cells_per_second = static_cast<double>(size) * size / seconds;
+        const double gbps = cells_per_second * bytes_per_cell * 1e-9;
+        const PerfSample counts = fluid.perf_counts(PerfPhase::Step);
+        fluid.set_perf_counters(false);
+
+        BenchResult result;
+        result.name = "solver/" + std::string(config.mode_name) + "/" + kernel_name + "/" + std::to_string(size) +
+                      "/t" + std::to_string(threads) + "/" + obstacles;
+        result.cells_per_second = cells_per_second;
+        char fields[512];
+        std::snprintf(fields, sizeof(fields),
+                      "\"mode\": \"%s\", \"kernels\": \"%s\", \"size\": %d, \"threads\": %d, \"obstacles\": \"%s\", "
+                      "\"seconds_per_step\": %.9g, \"cells_per_second\": %.6g, \"gbps\": %.4g, \"stream_fraction\": %.4g",
+                      config.mode_name, kernel_name.c_str(), size, threads, obstacles.c_str(),
+                      seconds, cells_per_second, gbps, gbps / stream_gbps);
+        result.json = fields;
+        if (counts[PerfEvent::Cycles] > 0) {
+            const double cell_updates = static_cast<double>(size) * size * steps;
+            std::snprintf(fields, sizeof(fields),
+                          ", \"cycles_per_cell\": %.4g, \"ipc\": %.4g, \"l1d_misses_per_cell\": %.4g, "
+                          "\"llc_misses_per_cell\": %.4g, \"branch_misses_per_cell\": %.4g",
+                          counts[PerfEvent::Cycles] / cell_updates,
+                          static_cast<double>(counts[PerfEvent::Instructions]) / counts[PerfEvent::Cycles],
+                          counts[PerfEvent::L1dReadMisses] / cell_updates, counts[PerfEvent::LlcMisses] / cell_updates,
+                          counts[PerfEvent::BranchMisses] / cell_updates);
+            result.json += fields;
+        }
+        results.push_back(result);
+
+        std::printf("%-48s %10.1f Mcell/s %8.2f GB/s %6.2f of STREAM\n", result.name.c_str(),
+                    cells_per_second * 1e-6, gbps, gbps / stream_gbps);
+        std::fflush(stdout);
+    }
+}
+
+static void benchSolvers(const BenchConfig& config, const double stream_gbps, std::vector<BenchResult>& results) {
+    for (const std::string& name : config.kernels) {
+        for (const int size : config.sizes) {
+            for (const int threads : threadCounts(config.threads)) {
+                if (name == "double") {
+                    benchSolver<double>(config, name, kernels::select<double>(), size, threads, stream_gbps, results);
+                } else if (name == "half") {
+                    benchSolver<Half>(config, name, kernels::select<Half>(), size, threads, stream_gbps, results);
+                } else if (const KernelSet* set = kernels::find(name.c_str())) {
+                    benchSolver<float>(config, name, *set, size, threads, stream_gbps, results);
+                } else {
+                    std::fprintf(stderr, "skipping kernel set %s: unknown or unsupported on this CPU\n", name.c_str());
+                    break;
+                }
+            }
+        }
+    }
+}
+
+static void benchDenormals(const BenchConfig& config, std::vector<BenchResult>& results) {
+    struct Protection {
+        const char* name;
+        bool flush;
+        float epsilon;
+    };
+    constexpr Protection protections[] = {
+        {"none", false, 0.0f},
+        {"flush", true, 0.0f},
+        {"snap", false, 1e-30f},
+        {"flush+snap", true, 1e-30f},
+    };
+    constexpr int size = 512;
+
+    for (const Protection& protection : protections) {
+        Fluid<> fluid(size, size, 1.0f / 48000.0f, 2.0f, 0.001f, size, size);
+        fluid.clear_obstacles();
+        fluid.set_denormal_protection(protection.flush, protection.epsilon);
+
+        // Splashes that have decayed by about 2^-150; letting them spread fills the
+        // whole grid with subnormal heights and velocities
+        for (int y = 4; y < size; y += 8) {
+            for (int x = 4; x < size; x += 8) {
+                fluid.add_velocity(x, y, 1e-41f * 20000.0f);
+            }
+        }
+        fluid.advance(64, 0.7f);
+
+        int steps = 0;
+        const double seconds = timeSteps(fluid, config.min_time, false, &steps);
+        const double cells_per_second = static_cast<double>(size) * size / seconds;
+        const float resting = fluid.resting_fraction();
+
+        BenchResult result;
+        result.name = std::string("denormals/") + protection.name;
+        result.cells_per_second = cells_per_second;
+        char fields[256];
+        std::snprintf(fields, sizeof(fields),
+                      "\"flush\": %s, \"epsilon\": %g, \"size\": %d, \"cells_per_second\": %.6g, "
+                      "\"resting_fraction\": %.4g",
+                      protection.flush ? "true" : "false", protection.epsilon, size, cells_per_second, resting);
+        result.json = fields;
+        results.push_back(result);
+
+        std::printf("%-48s %10.1f Mcell/s %8.3f resting\n", result.name.c_str(), cells_per_second * 1e-6, resting);
+        std::fflush(stdout);
+    }
+}
+
+#ifdef WAVESIM_BENCH_RENDER
+static void benchRender(const BenchConfig& config, std::vector<BenchResult>& results) {
+    // Headless unless a video driver was chosen explicitly
+    SDL_setenv("SDL_VIDEODRIVER", "dummy", 0);
+
+    constexpr int window_width = 1000;
+    constexpr int window_height = 600;
+    Renderer renderer("wavesim_bench", window_height, window_width, 60);
+    renderer.setFPS(1 << 20);  // Present without pacing
+    renderer.initialize();
+
+    for (const int downsample : {4, 2, 1}) {
+        const int width = window_width / downsample;
+        const int height = window_height / downsample;
+        Fluid<> fluid(height, width, 1.0f / 48000.0f, 2.0f, 0.001f, window_height, window_width);
+        fluid.add_velocity(window_width / 2, window_height / 2);
+        fluid.advance(480, 0.7f);
+        FluidSnapshot<> snapshot;
+        fluid.capture(snapshot);
+
+        FluidView view;
+        for (const char* path : {"texture", "rectangles"}) {
+            const auto frame = [&] {
+                if (std::strcmp(path, "texture") == 0) {
+                    view.render(snapshot, &renderer);
+                } else {
+                    renderer.clear();
+                    view.render_rectangles(snapshot, &renderer, downsample, downsample);
+                }
+                renderer.draw();
+            };
+
+            frame();
+            int frames = 0;
+            const auto start = std::chrono::steady_clock::now();
+            double seconds = 0.0;
+            while (seconds < config.min_time) {
+                frame();
+                frames++;
+                seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+            }
+
+            const double frames_per_second = frames / seconds;
+            const double cells_per_second = frames_per_second * width * height;
+            BenchResult result;
+            result.name = std::string("render/") + path + "/" + std::to_string(width) + "x" + std::to_string(height);
+            result.cells_per_second = cells_per_second;
+            char fields[256];
+            std::snprintf(fields, sizeof(fields),
+                          "\"path\": \"%s\", \"width\": %d, \"height\": %d, \"frames_per_second\": %.6g, "
+                          "\"cells_per_second\": %.6g",
+                          path, width, height, frames_per_second, cells_per_second);
+            result.json = fields;
+            results.push_back(result);
+
+            std::printf("%-48s %10.1f Mcell/s %8.1f fps\n", result.name.c_str(), cells_per_second * 1e-6,
+                        frames_per_second);
+            std::fflush(stdout);
+        }
+    }
+}
+#endif
+
+static void writeResults(const char* path, const double stream_gbps, const std::vector<BenchResult>& solver,
+                         const std::vector<BenchResult>& denormals, const std::vector<BenchResult>& render) {
+    std::ofstream out(path);
+    if (!out) {
+        std::fprintf(stderr, "could not open %s\n", path);
+        exit(1);
+    }
+
+    // One result per line, which is what --baseline reads back
+    out << "{\n";
+    out << "\"machine\": {\"threads\": " << std::max(1u, std::thread::hardware_concurrency())
+        << ", \"kernels\": \"" << kernels::select<float>().name << "\", \"stream_triad_gbps\": " << stream_gbps << "},\n";
+    const auto writeList = [&](const char* key, const std::vector<BenchResult>& results, const bool last) {
+        out << "\"" << key << "\": [\n";
+        for (size_t i = 0; i < results.size(); i++) {
+            out << "{\"name\": \"" << results[i].name << "\", " << results[i].json << "}"
+                << (i + 1 < results.size() ? ",\n" : "\n");
+        }
+        out << "]" << (last ? "\n" : ",\n");
+    };
+    writeList("solver", solver, false);
+    writeList("denormals", denormals, false);
+    writeList("render", render, true);
+    out << "}\n";
+}
+
+// Read back name and cells_per_second from a file written by writeResults
+static bool readBaseline(const char* path, std::vector<std::pair<std::string, double>>& baseline) {
+    std::ifstream in(path);
+    if (!in) {
+        return false;
+    }
+    std::string line;
+    while (std::getline(in, line)) {
+        const std::string name_key = "{\"name\": \"";
+        const std::string rate_key = "\"cells_per_second\": ";
+        const size_t name = line.find(name_key);
+        const size_t rate = line.find(rate_key);
+        if (name == std::string::npos || rate == std::string::npos) {
+            continue;
+        }
+        const size_t name_begin = name + name_key.size();
+        const size_t name_end = line.find('"', name_begin);
+        baseline.emplace_back(line.substr(name_begin, name_end - name_begin),
+                              std::atof(line.c_str() + rate + rate_key.size()));
+    }
+    return true;
+}
+
+// Print how each result compares with the baseline
+// @return Number of results slower than the baseline by more than the tolerance
+static int compareBaseline(const BenchConfig& config, const std::vector<BenchResult>& results) {
+    std::vector<std::pair<std::string, double>> baseline;
+    if (!readBaseline(config.baseline_path, baseline)) {
+        std::fprintf(stderr, "could not open %s\n", config.baseline_path);
+        exit(1);
+    }
+
+    int regressions = 0;
+    std::printf("\ncompared with %s (tolerance %.0f%%):\n", config.baseline_path, config.tolerance * 100.0);
+    for (const BenchResult& result : results) {
+        const auto it = std::find_if(baseline.begin(), baseline.end(), [&](const auto& entry) {
+            return entry.first == result.name;
+        });
+        if (it == baseline.end() || it->second <= 0.0) {
+            std::printf("%-48s   new\n", result.name.c_str());
+            continue;
+        }
+        const double ratio = result.cells_per_second / it->second;
+        const bool regressed = ratio < 1.0 - config.tolerance;
+        regressions += regressed ? 1 : 0;
+        std::printf("%-48s %7.3fx%s\n", result.name.c_str(), ratio, regressed ? "   REGRESSION" : "");
+    }
+    return regressions;
+}
+
+int main(int argc, char* argv[])
+{
+    const BenchConfig config = parseArgs(argc, argv);
+
+    const int hardware = static_cast<int>(std::max(1u, std::thread::hardware_concurrency()));
+    const double stream_gbps = streamTriad(hardware);
+    std::printf("STREAM triad %.2f GB/s on %d threads\n", stream_gbps, hardware);
+    if (config.perf) {
+        const PerfCounters probe;
+        if (!probe.available()) {
+            std::fprintf(stderr, "hardware counters unavailable (%s); results will not include them\n",
+                         probe.error().c_str());
+        }
+    }
+
+    std::vector<BenchResult> solver;
+    std::vector<BenchResult> denormals;
+    std::vector<BenchResult> render;
+    if (config.solver) {
+        benchSolvers(config, stream_gbps, solver);
+    }
+    if (config.denormals) {
+        benchDenormals(config, denormals);
+    }
+#ifdef WAVESIM_BENCH_RENDER
+    if (config.render) {
+        benchRender(config, render);
+    }
+#else
+    if (config.render) {
+        std::printf("render paths skipped: built without SDL2\n");
+    }
+#endif
+
+    writeResults(config.out_path, stream_gbps, solver, denormals, render);
+    std::printf("results written to %s\n", config.out_path);
+
+    if (config.baseline_path != nullptr) {
+        std::vector<BenchResult> all = solver;
+        all.insert(all.end(), denormals.begin(), denormals.end());
+        all.insert(all.end(), render.begin(), render.end());
+        if (compareBaseline(config, all) > 0) {
+            return 1;
+        }
+    }
+    return 0;
+}
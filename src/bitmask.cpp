@@ -0,0 +1,33 @@
+#include "../include/bitmask.h"
+
+#include <algorithm>
+
+void BitMask::assign(const size_t bits, const bool value) {
+    m_bits = bits;
+    m_words.assign(bits / 64 + 2, value ? ~uint64_t{0} : uint64_t{0});
+}
+
+void BitMask::fill(size_t pos, size_t count, const bool value) {
+    while (count > 0) {
+        const unsigned shift = pos % 64;
+        const size_t bits = std::min<size_t>(64 - shift, count);
+        const uint64_t mask = (bits == 64 ? ~uint64_t{0} : (uint64_t{1} << bits) - 1) << shift;
+        uint64_t& word = m_words[pos / 64];
+        word = value ? (word | mask) : (word & ~mask);
+        pos += bits;
+        count -= bits;
+    }
+}
+
+void BitMask::copy(size_t pos, const uint64_t* words, size_t from, size_t count) {
+    while (count > 0) {
+        const unsigned shift = pos % 64;
+        const size_t bits = std::min<size_t>(64 - shift, count);
+        const uint64_t mask = (bits == 64 ? ~uint64_t{0} : (uint64_t{1} << bits) - 1) << shift;
+        uint64_t& word = m_words[pos / 64];
+        word = (word & ~mask) | ((load_bits(words, from) << shift) & mask);
+        pos += bits;
+        from += bits;
+        count -= bits;
+    }
+}
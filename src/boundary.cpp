@@ -0,0 +1,210 @@
+#include "../include/boundary.h"
+
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+#include <numbers>
+
+template <typename Storage>
+BoundaryConditions<Storage>::BoundaryConditions() = default;
+
+template <typename Storage>
+const typename BoundaryConditions<Storage>::EdgeCondition& BoundaryConditions<Storage>::edge(const Edge edge) const {
+    return m_edges[static_cast<int>(edge)];
+}
+
+template <typename Storage>
+void BoundaryConditions<Storage>::set(const Edge edge, const BoundaryKind kind) {
+    EdgeCondition& condition = m_edges[static_cast<int>(edge)];
+    EdgeCondition& other = m_edges[static_cast<int>(opposite_edge(edge))];
+    if (kind == BoundaryKind::Periodic) {
+        other.kind = BoundaryKind::Periodic;
+    } else if (condition.kind == BoundaryKind::Periodic) {
+        other.kind = BoundaryKind::Reflective;
+    }
+    condition.kind = kind;
+    // Restarted by prepare
+    condition.history.clear();
+}
+
+template <typename Storage>
+void BoundaryConditions<Storage>::set_wave_maker(const Edge edge, const float amplitude, const float period) {
+    if (!(period > 0.0f)) {
+        std::cerr << "Wave maker period must be positive" << std::endl;
+        exit(1);
+    }
+    set(edge, BoundaryKind::WaveMaker);
+    m_edges[static_cast<int>(edge)].amplitude = amplitude;
+    m_edges[static_cast<int>(edge)].period = period;
+}
+
+template <typename Storage>
+BoundaryKind BoundaryConditions<Storage>::kind(const Edge edge) const {
+    return this->edge(edge).kind;
+}
+
+template <typename Storage>
+bool BoundaryConditions<Storage>::all_reflective() const {
+    for (const EdgeCondition& condition : m_edges) {
+        if (condition.kind != BoundaryKind::Reflective) {
+            return false;
+        }
+    }
+    return true;
+}
+
+template <typename Storage>
+bool BoundaryConditions<Storage>::periodic_x() const {
+    return edge(Edge::Left).kind == BoundaryKind::Periodic;
+}
+
+template <typename Storage>
+bool BoundaryConditions<Storage>::periodic_y() const {
+    return edge(Edge::Top).kind == BoundaryKind::Periodic;
+}
+
+template <typename Storage>
+void BoundaryConditions<Storage>::prepare(const Grid& grid, BitMask& wet) {
+    const int width = grid.width;
+    const int height = grid.height;
+    const int stride = grid.stride;
+    const auto idx = [stride](const int x, const int y) { return static_cast<size_t>(y + 1) * stride + x + 1; };
+
+    const bool wrap_x = periodic_x();
+    for (int y = 0; y < height; y++) {
+        wet.set(idx(-1, y), wrap_x && wet.test(idx(width - 1, y)));
+        wet.set(idx(width, y), wrap_x && wet.test(idx(0, y)));
+    }
+    const bool wrap_y = periodic_y();
+    for (int x = 0; x < width; x++) {
+        wet.set(idx(x, -1), wrap_y && wet.test(idx(x, height - 1)));
+        wet.set(idx(x, height), wrap_y && wet.test(idx(x, 0)));
+    }
+
+    // A new absorbing edge starts as if the water beside it had been still
+    for (int e = 0; e < static_cast<int>(Edge::Count); e++) {
+        EdgeCondition& condition = m_edges[e];
+        const bool horizontal = e == static_cast<int>(Edge::Top) || e == static_cast<int>(Edge::Bottom);
+        const size_t length = horizontal ? width : height;
+        if (condition.kind != BoundaryKind::Absorbing || condition.history.size() == length) {
+            continue;
+        }
+        condition.history.resize(length);
+        for (size_t i = 0; i < length; i++) {
+            const int x = horizontal ? static_cast<int>(i) : (e == static_cast<int>(Edge::Left) ? 1 : width - 2);
+            const int y = horizontal ? (e == static_cast<int>(Edge::Top) ? 1 : height - 2) : static_cast<int>(i);
+            condition.history[i] = precision_cast<Compute>(grid.H[y * stride + x]);
+        }
+    }
+}
+
+template <typename Storage>
+void BoundaryConditions<Storage>::fill_halo(const Grid& grid, const KernelRegion& rows) const {
+    const int stride = grid.stride;
+    if (periodic_x()) {
+        for (int y = rows.y_begin; y < rows.y_end; y++) {
+            Storage* h = grid.H + y * stride;
+            h[-1] = h[grid.width - 1];
+            h[grid.width] = h[0];
+        }
+    }
+    if (periodic_y()) {
+        if (rows.y_begin == 0 && rows.y_end > 0) {
+            std::copy_n(grid.H + (grid.height - 1) * stride, grid.width, grid.H - stride);
+        }
+        if (rows.y_end == grid.height && rows.y_begin < rows.y_end) {
+            std::copy_n(grid.H, grid.width, grid.H + grid.height * stride);
+        }
+    }
+}
+
+template <typename Storage>
+void BoundaryConditions<Storage>::applyCells(const Grid& grid, EdgeCondition& condition, const int x, const int y,
+                                             const int dx, const int dy, const int count, const int inward,
+                                             const int position, const Compute dt, const Compute speed,
+                                             const double time) {
+    const int step = dy * grid.stride + dx;
+    Storage* h = grid.H + y * grid.stride + x;
+    Storage* v = grid.V + y * grid.stride + x;
+    size_t bit = static_cast<size_t>(y + 1) * grid.stride + x + 1;
+
+    switch (condition.kind) {
+        case BoundaryKind::Reflective:
+            for (int i = 0; i < count; i++) {
+                v[i * step] = Storage{};
+            }
+            break;
+
+        case BoundaryKind::Absorbing: {
+            // Mur: h0' = h1 + k (h1' - h0), centred half a cell inside the edge and half a step
+            // ahead. The inner cell's next height is extrapolated from its last two heights.
+            const Compute k = (speed * dt - 1) / (speed * dt + 1);
+            Compute* history = condition.history.data() + position;
+            for (int i = 0; i < count; i++, bit += step) {
+                const bool open = load_bits(grid.Wet, bit) & load_bits(grid.Wet, bit + inward) & 1u;
+                const Compute edge_height = precision_cast<Compute>(h[i * step]);
+                const Compute inner_height = precision_cast<Compute>(h[i * step + inward]);
+                const Compute inner_previous = history[i];
+                history[i] = inner_height;
+                const Compute inner_next = 2 * inner_height - inner_previous;
+                const Compute next = inner_height + k * (inner_next - edge_height);
+                v[i * step] = open ? precision_cast<Storage>((next - edge_height) / dt) : Storage{};
+            }
+            break;
+        }
+
+        case BoundaryKind::WaveMaker: {
+            // Velocity that lands the edge exactly on the signal at the end of the step
+            const Compute target = static_cast<Compute>(
+                condition.amplitude * std::sin(2.0 * std::numbers::pi * time / condition.period));
+            for (int i = 0; i < count; i++, bit += step) {
+                const bool wet = load_bits(grid.Wet, bit) & 1u;
+                const Compute edge_height = precision_cast<Compute>(h[i * step]);
+                v[i * step] = wet ? precision_cast<Storage>((target - edge_height) / dt) : Storage{};
+            }
+            break;
+        }
+
+        case BoundaryKind::Periodic:
+            // Edge cells are ordinary cells; the ghost border already held their neighbours
+            break;
+    }
+}
+
+template <typename Storage>
+void BoundaryConditions<Storage>::apply(const Grid& grid, const KernelRegion& region, const Compute dt,
+                                        const Compute speed, const double time) {
+    if (region.x_begin >= region.x_end || region.y_begin >= region.y_end) {
+        return;
+    }
+
+    // Region bounds in grid coordinates; tile copies address a cell other than (0, 0)
+    const int x0 = region.x_begin + grid.x_offset;
+    const int x1 = region.x_end + grid.x_offset;
+    const int y0 = region.y_begin + grid.y_offset;
+    const int y1 = region.y_end + grid.y_offset;
+    const int columns = region.x_end - region.x_begin;
+    const int rows = region.y_end - region.y_begin;
+
+    // Rows first, so the left and right edges own the corners
+    if (y0 == 0) {
+        applyCells(grid, m_edges[static_cast<int>(Edge::Top)], region.x_begin, region.y_begin, 1, 0, columns,
+                   grid.stride, x0, dt, speed, time);
+    }
+    if (y1 == grid.height) {
+        applyCells(grid, m_edges[static_cast<int>(Edge::Bottom)], region.x_begin, region.y_end - 1, 1, 0, columns,
+                   -grid.stride, x0, dt, speed, time);
+    }
+    if (x0 == 0) {
+        applyCells(grid, m_edges[static_cast<int>(Edge::Left)], region.x_begin, region.y_begin, 0, 1, rows,
+                   1, y0, dt, speed, time);
+    }
+    if (x1 == grid.width) {
+        applyCells(grid, m_edges[static_cast<int>(Edge::Right)], region.x_end - 1, region.y_begin, 0, 1, rows,
+                   -1, y0, dt, speed, time);
+    }
+}
+
+template class BoundaryConditions<float>;
+template class BoundaryConditions<double>;
+template class BoundaryConditions<Half>;
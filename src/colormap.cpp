@@ -0,0 +1,108 @@
+#include "../include/colormap.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <iostream>
+
+namespace {
+    // Alpha of every entry; the view blends each frame over the last for a short trail
+    constexpr unsigned char alpha = 150;
+
+    uint32_t pack(const float r, const float g, const float b) {
+        const unsigned char bytes[4] = {
+            static_cast<unsigned char>(std::clamp(r, 0.0f, 255.0f)),
+            static_cast<unsigned char>(std::clamp(g, 0.0f, 255.0f)),
+            static_cast<unsigned char>(std::clamp(b, 0.0f, 255.0f)),
+            alpha,
+        };
+        uint32_t color;
+        std::memcpy(&color, bytes, sizeof(color));
+        return color;
+    }
+
+    struct PaletteRange {
+        float min;
+        float max;
+    };
+
+    PaletteRange range(const Palette palette) {
+        switch (palette) {
+            case Palette::Spectrum: return {1.0f, 10.0f};
+            default: return {-1.0f, 1.0f};
+        }
+    }
+
+    // Colour of a height at fraction t (0..1) of the palette range
+    uint32_t shade(const Palette palette, const float t) {
+        switch (palette) {
+            case Palette::Spectrum:
+                // Red increases with height, green peaks in the middle, blue decreases
+                return pack(255.0f * t, std::max(0.0f, 255.0f * (1.0f - 2.0f * std::abs(t - 0.5f))),
+                            255.0f * (1.0f - t));
+            case Palette::Grayscale:
+                return pack(255.0f * t, 255.0f * t, 255.0f * t);
+            case Palette::Diverging:
+                if (t < 0.5f) {
+                    const float u = 2.0f * t;
+                    return pack(255.0f * u, 255.0f * u, 255.0f);
+                } else {
+                    const float u = 2.0f * (1.0f - t);
+                    return pack(255.0f, 255.0f * u, 255.0f * u);
+                }
+            case Palette::Blue:
+            default:
+                return pack(45.0f, 35.0f, 256.0f * t);
+        }
+    }
+}
+
+Colormap::Colormap(const Palette palette, const int levels)
+    : m_palette(palette), m_levels(levels), m_lut{}
+{
+    if (m_levels < 2 || m_levels > 4096) {
+        std::cerr << "Colormap levels must be between 2 and 4096" << std::endl;
+        exit(1);
+    }
+    build();
+}
+
+void Colormap::set_palette(const Palette palette) {
+    m_palette = palette;
+    build();
+}
+
+Palette Colormap::palette() const {
+    return m_palette;
+}
+
+const ColorLut& Colormap::lut() const {
+    return m_lut;
+}
+
+const char* Colormap::name(const Palette palette) {
+    switch (palette) {
+        case Palette::Blue: return "blue";
+        case Palette::Spectrum: return "spectrum";
+        case Palette::Grayscale: return "grayscale";
+        case Palette::Diverging: return "diverging";
+        default: return "unknown";
+    }
+}
+
+void Colormap::build() {
+    const PaletteRange bounds = range(m_palette);
+
+    // Entry i covers heights from min + i / scale up to the next entry
+    m_colors.resize(m_levels + 1);
+    for (int i = 0; i < m_levels; i++) {
+        m_colors[i] = shade(m_palette, static_cast<float>(i) / m_levels);
+    }
+    // Obstacles
+    m_colors[m_levels] = pack(255.0f, 255.0f, 255.0f);
+
+    m_lut.colors = m_colors.data();
+    m_lut.levels = m_levels;
+    m_lut.offset = bounds.min;
+    m_lut.scale = m_levels / (bounds.max - bounds.min);
+}
@@ -1,17 +1,87 @@
 #include "../include/fluid.h"
-#include "../include/matplotlibcpp.h"
 
 #include <iostream>
+#include <cstdio>
 #include <cmath>
 #include <vector>
-#include <thread>
 #include <algorithm>
 #include <functional>
+#include <limits>
 
-namespace plt = matplotlibcpp;
+#ifdef WAVESIM_USE_OPENMP
+#include <omp.h>
+#endif
 
-Fluid::Fluid(const int height, const int width,const float dt,const float c,const float s,const int screen_height, const int screen_width)
-    : m_height(height) , m_width(width), m_dt(dt), m_c(c), m_s(s), m_screen_height(screen_height), m_screen_width(screen_width)
+#if defined(__SSE__) || defined(_M_X64)
+#include <xmmintrin.h>
+#endif
+
+namespace {
+    // Counters of the worker running on this thread during the current batch, if counting
+    thread_local const PerfCounters* t_perf_counters = nullptr;
+    thread_local PerfSample* t_perf_counts = nullptr;
+
+    // Sets flush-to-zero and denormals-are-zero on the calling thread for its lifetime
+    class DenormalGuard {
+    public:
+        explicit DenormalGuard(const bool enable) : m_enabled(enable) {
+            if (!m_enabled) {
+                return;
+            }
+#if defined(__SSE__) || defined(_M_X64)
+            m_saved = _mm_getcsr();
+            _mm_setcsr(m_saved | 0x8040);  // FTZ and DAZ
+#elif defined(__aarch64__)
+            __asm__ __volatile__("mrs %0, fpcr" : "=r"(m_saved));
+            __asm__ __volatile__("msr fpcr, %0" : : "r"(m_saved | (uint64_t(1) << 24)));  // FZ
+#endif
+        }
+
+        ~DenormalGuard() {
+            if (!m_enabled) {
+                return;
+            }
+#if defined(__SSE__) || defined(_M_X64)
+            _mm_setcsr(static_cast<unsigned int>(m_saved));
+#elif defined(__aarch64__)
+            __asm__ __volatile__("msr fpcr, %0" : : "r"(m_saved));
+#endif
+        }
+
+    private:
+        bool m_enabled;
+        uint64_t m_saved = 0;
+    };
+
+    // Adds the events counted during its lifetime to one phase of the calling worker
+    class PerfScope {
+    public:
+        explicit PerfScope(const PerfPhase phase) : m_phase(static_cast<int>(phase)) {
+            if (t_perf_counters != nullptr) {
+                m_start = t_perf_counters->read();
+            }
+        }
+
+        ~PerfScope() {
+            if (t_perf_counters != nullptr) {
+                t_perf_counts[m_phase] += t_perf_counters->read() - m_start;
+            }
+        }
+
+    private:
+        int m_phase;
+        PerfSample m_start;
+    };
+}
+
+template <typename Storage>
+Fluid<Storage>::Fluid(const int height, const int width,const float dt,const float c,const float s,const int screen_height, const int screen_width)
+    : m_height(height) , m_width(width), m_stride(width + 2), m_dt(dt), m_c(c), m_s(s), m_screen_height(screen_height), m_screen_width(screen_width), m_time(0.0), m_steps(0), m_porous_cells(0),
+      m_kernels(&kernels::select<Storage>()), m_layer(width, height), m_batch_start(0), m_step_mode(StepMode::Fused), m_threads(1),
+      m_block_depth(16), m_block_tile(256),
+      m_sparse_tile(32), m_sparse_threshold(0.0f), m_active_fraction(1.0f),
+      m_probe_recorder(nullptr), m_probe_records(0), m_perf_enabled(false),
+      m_flush_denormals(false), m_snap_epsilon(0)
 {
     // Check simulation stability criteria
     if (m_dt * m_c >= m_s) {
@@ -22,217 +92,1121 @@ Fluid::Fluid(const int height, const int width,const float dt,const float c,cons
     // Initialize simulation arrays
     initializeArrays();
 
-    std::cout << "Fluid initialized with a grid of size:" << m_height << " x " << m_width << std::endl;
+    std::cout << "Fluid initialized with a grid of size:" << m_height << " x " << m_width
+              << " using " << m_kernels->name << " kernels" << std::endl;
 
     // Generate sierpinski carpet obstacle pattern
     const int carpet_size = m_height * 0.95;
     constexpr int level = 3; // Using direct value instead of pow(2,3) for clarity
     generate_sierpinski_carpet(m_width / 2 - carpet_size / 2, m_height / 2 - carpet_size / 2, carpet_size, level);
+}
 
-    // Uncomment to start plotting thread
-    // m_plot_thread = std::thread(&Fluid::plot_waves, this);
+template <typename Storage>
+void Fluid<Storage>::initializeArrays() {
+    // Resize arrays, including the ghost border
+    const int padded_size = (m_height + 2) * m_stride;
+    m_H.resize(padded_size, Storage{});
+    m_V.resize(padded_size, Storage{});
+    m_Wet.assign(padded_size, false);
+    clear_obstacles();
 }
 
-Fluid::~Fluid() {
-    if (m_plot_thread.joinable()) {
-        m_plot_thread.join();
+template <typename Storage>
+void Fluid<Storage>::clear_obstacles() {
+    // Only the interior is wet; ghost cells stay dry so out-of-range neighbours contribute nothing
+    for (int y = 0; y < m_height; y++) {
+        m_Wet.fill(transform_idx(0, y), m_width, true);
     }
+    m_porosity.clear();
+    m_porous_cells = 0;
+    m_porous_rows.clear();
 }
 
-void Fluid::initializeArrays() {
-    // Resize arrays
-    m_H.resize(m_height * m_width, 0.0f);
-    m_V.resize(m_height * m_width, 0.0f);
-    m_Wet.resize(m_height * m_width, 1.0f);
+template <typename Storage>
+void Fluid<Storage>::add_structure(const int x, const int y, const int width, const int height, const float porosity) {
+    for (int j = std::max(y, 0); j < std::min(y + height, m_height); j++) {
+        for (int i = std::max(x, 0); i < std::min(x + width, m_width); i++) {
+            setPorosity(i, j, porosity);
+        }
+    }
 }
 
-int Fluid::transform_idx(const int x,const int y) const {
-    return y * m_width + x;
+template <typename Storage>
+float Fluid<Storage>::porosity(const int x, const int y) const {
+    const int idx = transform_idx(x, y);
+    if (!m_Wet.test(idx)) {
+        return 0.0f;
+    }
+    return m_porosity.empty() ? 1.0f : precision_cast<float>(m_porosity[idx]);
 }
 
-float Fluid::get_height(int x, int y, int x0, int y0) const {
-    if (x < 0 || x >= m_width || y < 0 || y >= m_height) {
-        return 0.0f;  // Return 0 for out-of-bounds
+template <typename Storage>
+void Fluid<Storage>::setPorosity(const int x, const int y, const float porosity) {
+    if (!(porosity >= 0.0f && porosity <= 1.0f)) {
+        std::cerr << "Porosity must lie between 0 and 1" << std::endl;
+        exit(1);
     }
-    return m_H[transform_idx(x, y)];
+    const int idx = transform_idx(x, y);
+    // Judged as stored, so a porosity that rounds to 0 or 1 does not leave the bitmask path
+    const float kept = precision_cast<float>(precision_cast<Storage>(porosity));
+    const bool porous = kept > 0.0f && kept < 1.0f;
+    const bool was_porous = !m_porosity.empty() && m_Wet.test(idx) &&
+                            precision_cast<float>(m_porosity[idx]) < 1.0f;
+
+    m_Wet.set(idx, kept > 0.0f);
+    if (porous && m_porosity.empty()) {
+        m_porosity.assign(m_H.size(), precision_cast<Storage>(1.0f));
+        m_porous_rows.assign(m_height, 0);
+    }
+    if (!m_porosity.empty()) {
+        m_porosity[idx] = precision_cast<Storage>(kept);
+        const int change = static_cast<int>(porous) - static_cast<int>(was_porous);
+        m_porous_cells += change;
+        m_porous_rows[y] += change;
+        if (m_porous_cells == 0) {
+            m_porosity.clear();
+            m_porous_rows.clear();
+        }
+    }
+    wakeTile(x, y);
 }
 
-float Fluid::get_wet(int x, int y) const {
-    return m_Wet[transform_idx(x, y)];
+template <typename Storage>
+bool Fluid<Storage>::porousRow(const int y) const {
+    // Faces reach one row up and down; the first and last rows also check each other for periodic edges
+    const int above = y > 0 ? y - 1 : m_height - 1;
+    const int below = y < m_height - 1 ? y + 1 : 0;
+    return m_porous_rows[above] + m_porous_rows[y] + m_porous_rows[below] > 0;
 }
 
-float Fluid::acceleration(int x, int y, int x0, int y0) const {
-    const float height0 = get_height(x0, y0, x0, y0);
-    const float height1 = get_height(x, y, x0, y0);
-    const float wet = get_wet(x, y);
-    return wet * (height1 - height0);
+template <typename Storage>
+void Fluid<Storage>::wrapPorosity() {
+    // Periodic edges read the ghost border as the opposite edge, porosity included.
+    // Other ghost cells are dry, so their porosity is never used.
+    if (m_porosity.empty()) {
+        return;
+    }
+    for (int y = 0; y < m_height; y++) {
+        m_porosity[transform_idx(-1, y)] = m_porosity[transform_idx(m_width - 1, y)];
+        m_porosity[transform_idx(m_width, y)] = m_porosity[transform_idx(0, y)];
+    }
+    for (int x = 0; x < m_width; x++) {
+        m_porosity[transform_idx(x, -1)] = m_porosity[transform_idx(x, m_height - 1)];
+        m_porosity[transform_idx(x, m_height)] = m_porosity[transform_idx(x, 0)];
+    }
 }
 
-void Fluid::step(const float halflife) {
-    const float damp = pow(0.5, m_dt/halflife);
-    const float c_squared_over_s_squared = pow(m_c, 2) / pow(m_s, 2);
+template <typename Storage>
+int Fluid<Storage>::transform_idx(const int x,const int y) const {
+    return (y + 1) * m_stride + (x + 1);
+}
 
-    // Update velocities
-    updateVelocities(damp, c_squared_over_s_squared);
+template <typename Storage>
+float Fluid<Storage>::get_wet(int x, int y) const {
+    return m_Wet.test(transform_idx(x, y)) ? 1.0f : 0.0f;
+}
 
-    // Apply boundary conditions
-    applyBoundaryConditions();
+template <typename Storage>
+typename Fluid<Storage>::Grid Fluid<Storage>::grid() {
+    const int origin = transform_idx(0, 0);
+    return {&m_H[origin], &m_V[origin], m_Wet.data(), m_width, m_height, m_stride, 0, 0};
+}
 
-    // Update heights
-    updateHeights();
+template <typename Storage>
+void Fluid<Storage>::set_kernels(const Kernels& kernels) {
+    m_kernels = &kernels;
 }
 
-void Fluid::updateVelocities(const float damp,const float c_squared_over_s_squared) {
-    for (int y = 0; y < m_height; y++) {
-        for (int x = 0; x < m_width; x++) {
-            if (get_wet(x, y) > 0.0f) {
-                const float top = acceleration(x, y + 1, x, y);
-                const float bottom = acceleration(x, y - 1, x, y);
-                const float left = acceleration(x - 1, y, x, y);
-                const float right = acceleration(x + 1, y, x, y);
-                const float acc = c_squared_over_s_squared * (top + bottom + left + right);
-                const int idx = transform_idx(x, y);
-                m_V[idx] = damp * m_V[idx] + m_dt * acc;
+template <typename Storage>
+void Fluid<Storage>::set_threads(const int threads) {
+    m_threads = threads > 0 ? threads : std::max(1u, std::thread::hardware_concurrency());
+
+#ifndef WAVESIM_USE_OPENMP
+    m_pool.reset();
+    if (m_threads > 1) {
+        m_pool = std::make_unique<ThreadPool>(m_threads);
+    }
+#endif
+}
+
+template <typename Storage>
+KernelRegion Fluid<Storage>::rowBand(const int worker, const int workers) const {
+    return {0, m_width, m_height * worker / workers, m_height * (worker + 1) / workers};
+}
+
+template <typename Storage>
+void Fluid<Storage>::set_step_mode(const StepMode mode) {
+    m_step_mode = mode;
+}
+
+template <typename Storage>
+void Fluid<Storage>::set_boundary(const Edge edge, const BoundaryKind kind) {
+    if (kind == BoundaryKind::Periodic && (m_layer.thickness(edge) > 0 || m_layer.thickness(opposite_edge(edge)) > 0)) {
+        std::cerr << "Edges lined with an absorbing layer cannot be periodic" << std::endl;
+        exit(1);
+    }
+    m_boundaries.set(edge, kind);
+    wakeEdges();
+}
+
+template <typename Storage>
+void Fluid<Storage>::set_wave_maker(const Edge edge, const float amplitude, const float period) {
+    m_boundaries.set_wave_maker(edge, amplitude, period);
+    wakeEdges();
+}
+
+template <typename Storage>
+BoundaryKind Fluid<Storage>::boundary(const Edge edge) const {
+    return m_boundaries.kind(edge);
+}
+
+template <typename Storage>
+void Fluid<Storage>::set_absorbing_layer(const Edge edge, const int thickness, const float reflection) {
+    if (thickness > 0 && m_boundaries.kind(edge) == BoundaryKind::Periodic) {
+        std::cerr << "Periodic edges cannot be lined with an absorbing layer" << std::endl;
+        exit(1);
+    }
+    m_layer.set(edge, thickness, reflection, m_c / m_s);
+}
+
+template <typename Storage>
+void Fluid<Storage>::set_medium(const std::vector<float>& speed, const std::vector<float>& damping_rate) {
+    const size_t cells = static_cast<size_t>(m_width) * m_height;
+    if ((!speed.empty() && speed.size() != cells) || (!damping_rate.empty() && damping_rate.size() != cells)) {
+        std::cerr << "Medium fields need one value per cell" << std::endl;
+        exit(1);
+    }
+
+    // Stored as factors of the uniform coefficients, see BasicMediumFields
+    std::vector<Storage> speed_squared(cells, precision_cast<Storage>(1.0f));
+    std::vector<Storage> damping(cells, precision_cast<Storage>(1.0f));
+    bool uniform = true;
+    for (size_t i = 0; i < speed.size(); i++) {
+        if (!(speed[i] >= 0.0f && speed[i] <= m_c)) {
+            std::cerr << "Wave speed must lie between 0 and c" << std::endl;
+            exit(1);
+        }
+        const Compute ratio = speed[i] / m_c;
+        speed_squared[i] = precision_cast<Storage>(ratio * ratio);
+        uniform &= speed[i] == m_c;
+    }
+    for (size_t i = 0; i < damping_rate.size(); i++) {
+        if (!(damping_rate[i] >= 0.0f)) {
+            std::cerr << "Damping rate must not be negative" << std::endl;
+            exit(1);
+        }
+        damping[i] = precision_cast<Storage>(std::exp(-damping_rate[i] * m_dt));
+        uniform &= damping_rate[i] == 0.0f;
+    }
+
+    if (uniform) {
+        m_medium_speed.clear();
+        m_medium_damping.clear();
+    } else {
+        m_medium_speed = std::move(speed_squared);
+        m_medium_damping = std::move(damping);
+    }
+    // Water at rest where it is still may not be balanced under the new coefficients
+    m_tile_quiet.clear();
+}
+
+template <typename Storage>
+void Fluid<Storage>::set_temporal_blocking(const int depth, const int tile_size) {
+    m_block_depth = std::max(1, depth);
+    m_block_tile = std::max(1, tile_size);
+}
+
+template <typename Storage>
+void Fluid<Storage>::set_sparse_tracking(const int tile_size, const float threshold) {
+    m_sparse_tile = std::max(1, tile_size);
+    m_sparse_threshold = threshold;
+    m_tile_quiet.clear();
+}
+
+template <typename Storage>
+float Fluid<Storage>::active_fraction() const {
+    return m_active_fraction;
+}
+
+template <typename Storage>
+double Fluid<Storage>::sim_time() const {
+    return m_time;
+}
+
+template <typename Storage>
+uint64_t Fluid<Storage>::step_count() const {
+    return m_steps;
+}
+
+template <typename Storage>
+double Fluid<Storage>::dt() const {
+    return m_dt;
+}
+
+template <typename Storage>
+double Fluid<Storage>::height_at(const int x, const int y) const {
+    return precision_cast<double>(m_H[transform_idx(x, y)]);
+}
+
+template <typename Storage>
+bool Fluid<Storage>::is_wet(const int x, const int y) const {
+    return m_Wet.test(transform_idx(x, y));
+}
+
+template <typename Storage>
+void Fluid<Storage>::map_colors(const ColorLut& lut, uint32_t* pixels, const int pitch) const {
+    WAVESIM_ZONE("map_colors");
+    // The colour kernel only reads H and Wet, so a read-only view is safe to hand out
+    const int origin = transform_idx(0, 0);
+    const Grid view = {const_cast<Storage*>(&m_H[origin]), nullptr, m_Wet.data(), m_width, m_height, m_stride, 0, 0};
+    m_kernels->map_colors(view, {0, m_width, 0, m_height}, lut, pixels, pitch);
+}
+
+template <typename Storage>
+void Fluid<Storage>::capture(FluidSnapshot<Storage>& snapshot) const {
+    WAVESIM_ZONE("capture");
+    snapshot.m_H = m_H;
+    snapshot.m_Wet = m_Wet;
+    snapshot.m_width = m_width;
+    snapshot.m_height = m_height;
+    snapshot.m_stride = m_stride;
+    snapshot.m_time = m_time;
+    snapshot.m_steps = m_steps;
+    snapshot.m_kernels = m_kernels;
+}
+
+template <typename Storage>
+void Fluid<Storage>::add_snapshot_channel(SnapshotChannel& channel) {
+    if (channel.source_width() != m_width || channel.source_height() != m_height) {
+        std::cerr << "Snapshot channel size does not match the grid" << std::endl;
+        exit(1);
+    }
+    m_snapshot_channels.push_back(&channel);
+}
+
+template <typename Storage>
+void Fluid<Storage>::remove_snapshot_channel(SnapshotChannel& channel) {
+    m_snapshot_channels.erase(std::remove(m_snapshot_channels.begin(), m_snapshot_channels.end(), &channel),
+                              m_snapshot_channels.end());
+}
+
+template <typename Storage>
+int Fluid<Storage>::add_probe(const int x, const int y) {
+    if (x < 0 || x >= m_width || y < 0 || y >= m_height) {
+        std::cerr << "Probe (" << x << ", " << y << ") lies outside the grid" << std::endl;
+        exit(1);
+    }
+    if (m_probe_recorder != nullptr) {
+        std::cerr << "Probes cannot be added while a recorder is attached" << std::endl;
+        exit(1);
+    }
+    m_probes.push_back({x, y});
+    return static_cast<int>(m_probes.size()) - 1;
+}
+
+template <typename Storage>
+void Fluid<Storage>::record_probes(ProbeRecorder* recorder) {
+    if (recorder != nullptr && recorder->probes() != static_cast<int>(m_probes.size())) {
+        std::cerr << "Probe recorder size does not match the registered probes" << std::endl;
+        exit(1);
+    }
+    m_probe_recorder = recorder;
+}
+
+template <typename Storage>
+void Fluid<Storage>::sampleProbes(const Grid& grid, const KernelRegion& region, const int substep) {
+    if (m_probe_recorder == nullptr || static_cast<size_t>(substep) >= m_probe_records) {
+        return;
+    }
+    float* heights = m_probe_recorder->heights(substep);
+    float* velocities = m_probe_recorder->velocities(substep);
+
+    // Regions handed in per substep never overlap, so each probe is written by exactly one thread
+    for (size_t k = 0; k < m_probes.size(); k++) {
+        const int x = m_probes[k].x - grid.x_offset;
+        const int y = m_probes[k].y - grid.y_offset;
+        if (x < region.x_begin || x >= region.x_end || y < region.y_begin || y >= region.y_end) {
+            continue;
+        }
+        heights[k] = precision_cast<float>(grid.H[y * grid.stride + x]);
+        if (velocities != nullptr) {
+            velocities[k] = precision_cast<float>(grid.V[y * grid.stride + x]);
+        }
+    }
+}
+
+template <typename Storage>
+int Fluid<Storage>::stepsToNextSnapshot() const {
+    int steps = std::numeric_limits<int>::max();
+    for (const SnapshotChannel* channel : m_snapshot_channels) {
+        const int cadence = channel->cadence();
+        steps = std::min(steps, cadence - static_cast<int>(m_steps % cadence));
+    }
+    return steps;
+}
+
+template <typename Storage>
+void Fluid<Storage>::publishSnapshots() {
+    WAVESIM_ZONE("publishSnapshots");
+    for (SnapshotChannel* channel : m_snapshot_channels) {
+        if (m_steps % channel->cadence() != 0) {
+            continue;
+        }
+        SnapshotFrame* frame = channel->begin_write();
+        if (frame == nullptr) {
+            continue;
+        }
+
+        // Average each block of cells; blocks on the right and bottom edges may be partial
+        const int block = channel->downsample();
+        for (int by = 0; by < channel->height(); by++) {
+            const int y_end = std::min(m_height, (by + 1) * block);
+            for (int bx = 0; bx < channel->width(); bx++) {
+                const int x_end = std::min(m_width, (bx + 1) * block);
+                float sum = 0.0f;
+                for (int y = by * block; y < y_end; y++) {
+                    for (int x = bx * block; x < x_end; x++) {
+                        sum += precision_cast<float>(m_H[transform_idx(x, y)]);
+                    }
+                }
+                frame->heights[by * channel->width() + bx] = sum / ((y_end - by * block) * (x_end - bx * block));
             }
         }
+        frame->time = m_time;
+        frame->step = m_steps;
+        channel->end_write();
     }
 }
 
-void Fluid::applyBoundaryConditions() {
+template <typename Storage>
+int Fluid<Storage>::width() const {
+    return m_width;
+}
+
+template <typename Storage>
+int Fluid<Storage>::height() const {
+    return m_height;
+}
+
+template <typename Storage>
+void Fluid<Storage>::step(const float halflife) {
+    advance(1, halflife);
+}
+
+template <typename Storage>
+void Fluid<Storage>::advance(const int substeps, const float halflife) {
+    if (substeps <= 0) {
+        return;
+    }
+    WAVESIM_ZONE("advance");
+
+    const Compute damp = pow(0.5, m_dt/halflife);
+    const Compute c_squared_over_s_squared = pow(m_c, 2) / pow(m_s, 2);
+
+    // Split the batch at every step a snapshot channel is due
+    for (int done = 0; done < substeps;) {
+        const int chunk = std::min(substeps - done, stepsToNextSnapshot());
+        advanceSteps(chunk, damp, c_squared_over_s_squared);
+        done += chunk;
+        publishSnapshots();
+    }
+}
+
+template <typename Storage>
+void Fluid<Storage>::advanceSteps(const int substeps, const Compute damp, const Compute c_squared_over_s_squared) {
+    const uint64_t first_step = m_steps + 1;
+    m_batch_start = m_steps;
+    m_time += substeps * static_cast<double>(m_dt);
+    m_steps += substeps;
+
+    m_probe_records = m_probe_recorder != nullptr ? m_probe_recorder->reserve(substeps) : 0;
+
+    // Obstacles may have changed since the last batch, so the periodic halo is marked again
+    m_boundaries.prepare(grid(), m_Wet);
+    wrapPorosity();
+
+    if (m_perf_enabled) {
+        beginPerfBatch();
+    }
+
+    // Tiles recompute their halos, which only works for conditions without state outside the edge cells
+    if (m_step_mode == StepMode::TemporalBlocked && m_boundaries.all_reflective() && !m_layer.active()) {
+        advanceBlocked(substeps, damp, c_squared_over_s_squared);
+    } else if (m_step_mode == StepMode::Sparse) {
+        advanceSparse(substeps, damp, c_squared_over_s_squared);
+    } else {
+        advanceBands(substeps, damp, c_squared_over_s_squared);
+    }
+
+    if (m_perf_enabled) {
+        endPerfBatch();
+    }
+
+    if (m_probe_recorder != nullptr) {
+        m_probe_recorder->commit(m_probe_records, first_step);
+    }
+}
+
+template <typename Storage>
+void Fluid<Storage>::set_denormal_protection(const bool flush_denormals, const float epsilon) {
+    m_flush_denormals = flush_denormals;
+    m_snap_epsilon = static_cast<Compute>(std::abs(epsilon));
+}
+
+template <typename Storage>
+float Fluid<Storage>::resting_fraction() const {
+    size_t wet = 0;
+    size_t resting = 0;
     for (int y = 0; y < m_height; y++) {
         for (int x = 0; x < m_width; x++) {
-            if (x == 0 || x == m_width - 1 || y == 0 || y == m_height - 1) {
-                // Apply zero velocity at boundaries
-                m_V[transform_idx(x, y)] = 0.0f;
+            const int idx = transform_idx(x, y);
+            if (m_Wet.test(idx)) {
+                wet++;
+                resting += precision_cast<float>(m_V[idx]) == 0.0f ? 1 : 0;
             }
         }
     }
+    return wet > 0 ? static_cast<float>(resting) / static_cast<float>(wet) : 1.0f;
 }
 
-void Fluid::updateHeights() {
-    for (int y = 0; y < m_height; y++) {
-        for (int x = 0; x < m_width; x++) {
-            if (get_wet(x, y) > 0.0f) {
-                const int idx = transform_idx(x, y);
-                m_H[idx] += m_dt * m_V[idx];
+template <typename Storage>
+bool Fluid<Storage>::set_perf_counters(const bool enabled) {
+    m_perf_enabled = enabled;
+    m_perf_error.clear();
+    for (PerfWorker& worker : m_perf_workers) {
+        for (PerfSample& counts : worker.counts) {
+            counts = PerfSample();
+        }
+    }
+    if (!enabled) {
+        return true;
+    }
+
+    // Probe once on this thread so that unavailable counters are reported straight away
+    const PerfCounters probe;
+    if (!probe.available()) {
+        m_perf_enabled = false;
+        m_perf_error = probe.error();
+        return false;
+    }
+    return true;
+}
+
+template <typename Storage>
+PerfSample Fluid<Storage>::perf_counts(const PerfPhase phase) const {
+    PerfSample total;
+    for (const PerfWorker& worker : m_perf_workers) {
+        total += worker.counts[static_cast<int>(phase)];
+    }
+    return total;
+}
+
+template <typename Storage>
+const std::string& Fluid<Storage>::perf_error() const {
+    return m_perf_error;
+}
+
+template <typename Storage>
+void Fluid<Storage>::beginPerfBatch() {
+    if (m_perf_workers.size() < static_cast<size_t>(m_threads)) {
+        m_perf_workers.resize(m_threads);
+    }
+
+    // Counters only see the thread that opened them, so each worker opens its own, again
+    // if a different thread now runs that worker (e.g. advance called from another thread)
+    parallel([&](const int worker, int) {
+        PerfWorker& perf = m_perf_workers[worker];
+        if (!perf.counters || perf.counters->thread() != std::this_thread::get_id()) {
+            perf.counters = std::make_unique<PerfCounters>();
+        }
+        if (perf.counters->available()) {
+            t_perf_counters = perf.counters.get();
+            t_perf_counts = perf.counts;
+            perf.batch_start = perf.counters->read();
+        }
+    });
+}
+
+template <typename Storage>
+void Fluid<Storage>::endPerfBatch() {
+    parallel([&](const int worker, int) {
+        PerfWorker& perf = m_perf_workers[worker];
+        if (t_perf_counters != nullptr) {
+            perf.counts[static_cast<int>(PerfPhase::Step)] += t_perf_counters->read() - perf.batch_start;
+        }
+        t_perf_counters = nullptr;
+        t_perf_counts = nullptr;
+    });
+}
+
+template <typename Storage>
+void Fluid<Storage>::advanceBands(const int substeps, const Compute damp, const Compute c_squared_over_s_squared) {
+    const Grid g = grid();
+
+    // Each thread owns a band of rows. Velocities read the heights of neighbouring bands, so
+    // the rows that neighbours read must get their velocities before any height changes, and
+    // all heights must be final before the next substep starts.
+    parallel([&](const int worker, const int workers) {
+        const KernelRegion band = rowBand(worker, workers);
+        for (int i = 0; i < substeps; i++) {
+            // Heights only change after the barrier below, so bands can fill their halos side by side
+            m_boundaries.fill_halo(g, band);
+            if (workers == 1) {
+                stepBand(g, band, damp, c_squared_over_s_squared, false, i);
+                sampleProbes(g, band, i);
+                continue;
+            }
+            prepareBand(g, band, damp, c_squared_over_s_squared, i);
+            barrier();
+            stepBand(g, band, damp, c_squared_over_s_squared, true, i);
+            sampleProbes(g, band, i);
+            if (i + 1 < substeps) {
+                barrier();
             }
         }
+    });
+}
+
+// A template rather than std::function so that wrapping the job never allocates
+template <typename Storage>
+template <typename Job>
+void Fluid<Storage>::parallel(const Job& job) {
+    if (m_threads <= 1) {
+        DenormalGuard guard(m_flush_denormals);
+        job(0, 1);
+        return;
     }
+
+#ifdef WAVESIM_USE_OPENMP
+    #pragma omp parallel num_threads(m_threads)
+    {
+        DenormalGuard guard(m_flush_denormals);
+        job(omp_get_thread_num(), omp_get_num_threads());
+    }
+#else
+    m_pool->run([&](const int worker) {
+        DenormalGuard guard(m_flush_denormals);
+        job(worker, m_pool->size());
+    });
+#endif
 }
 
-void Fluid::generate_sierpinski_carpet(const int x,const int y,const int size,const int level) {
-    if (level == 0 || size < 3) return;
+template <typename Storage>
+void Fluid<Storage>::barrier() {
+    if (m_threads <= 1) {
+        return;
+    }
+    WAVESIM_ZONE("barrier");
 
-    const int newSize = size / 3;
+#ifdef WAVESIM_USE_OPENMP
+    #pragma omp barrier
+#else
+    m_pool->barrier();
+#endif
+}
 
-    // Create the central empty square
-    for (int i = x + newSize; i < x + 2 * newSize; ++i) {
-        for (int j = y + newSize; j < y + 2 * newSize; ++j) {
-            m_Wet[transform_idx(i, j)] = 0.0f;
+template <typename Storage>
+void Fluid<Storage>::prepareBand(const Grid& grid, const KernelRegion& band, const Compute damp,
+                                 const Compute c_squared_over_s_squared, const int substep) {
+    if (m_step_mode == StepMode::ThreePass) {
+        // Every velocity reads neighbouring heights
+        {
+            WAVESIM_ZONE("updateVelocities");
+            PerfScope scope(PerfPhase::Velocities);
+            updateVelocities(grid, band, damp, c_squared_over_s_squared, substep);
         }
+        WAVESIM_ZONE("applyBoundaryConditions");
+        PerfScope scope(PerfPhase::Boundaries);
+        applyBoundaryConditions(grid, band, substep);
+        return;
     }
 
-    // Recursively generate all 8 surrounding squares
-    for (int dx = 0; dx < 3; ++dx) {
-        for (int dy = 0; dy < 3; ++dy) {
-            if (dx == 1 && dy == 1) continue;  // Skip the center
-            generate_sierpinski_carpet(x + dx * newSize, y + dy * newSize, newSize, level - 1);
+    // Only the first and last rows read heights owned by other bands
+    WAVESIM_ZONE("prepareBand");
+    if (band.y_begin < band.y_end) {
+        const KernelRegion first = {band.x_begin, band.x_end, band.y_begin, band.y_begin + 1};
+        updateVelocities(grid, first, damp, c_squared_over_s_squared, substep);
+        applyBoundaryConditions(grid, first, substep);
+    }
+    if (band.y_end - 1 > band.y_begin) {
+        const KernelRegion last = {band.x_begin, band.x_end, band.y_end - 1, band.y_end};
+        updateVelocities(grid, last, damp, c_squared_over_s_squared, substep);
+        applyBoundaryConditions(grid, last, substep);
+    }
+}
+
+template <typename Storage>
+void Fluid<Storage>::stepBand(const Grid& grid, const KernelRegion& band, const Compute damp,
+                              const Compute c_squared_over_s_squared, const bool prepared, const int substep) {
+    if (m_step_mode == StepMode::ThreePass) {
+        if (!prepared) {
+            // Update velocities
+            {
+                WAVESIM_ZONE("updateVelocities");
+                PerfScope scope(PerfPhase::Velocities);
+                updateVelocities(grid, band, damp, c_squared_over_s_squared, substep);
+            }
+
+            // Apply boundary conditions
+            WAVESIM_ZONE("applyBoundaryConditions");
+            PerfScope scope(PerfPhase::Boundaries);
+            applyBoundaryConditions(grid, band, substep);
         }
+
+        // Update heights
+        WAVESIM_ZONE("updateHeights");
+        PerfScope scope(PerfPhase::Heights);
+        updateHeights(grid, band);
+        return;
     }
+
+    // Fused sweep: the velocities of row y read the old heights of rows y-1..y+1, so heights
+    // trail one row behind and each row is finished while it is still in cache. Rows set up by
+    // prepareBand already have their velocities. Zones stay out of the per-row calls.
+    WAVESIM_ZONE("fusedSweep");
+    const int first = prepared ? band.y_begin + 1 : band.y_begin;
+    const int last = prepared ? band.y_end - 1 : band.y_end;
+    int pending = band.y_begin;  // First row whose heights are not updated yet
+
+    for (int y = first; y < last; y++) {
+        const KernelRegion row = {band.x_begin, band.x_end, y, y + 1};
+        updateVelocities(grid, row, damp, c_squared_over_s_squared, substep);
+        applyBoundaryConditions(grid, row, substep);
+
+        if (y - 1 >= pending) {
+            updateHeights(grid, {band.x_begin, band.x_end, y - 1, y});
+            pending = y;
+        }
+    }
+    updateHeights(grid, {band.x_begin, band.x_end, pending, band.y_end});
 }
 
-void Fluid::add_velocity(int x, int y) {
-    // Convert screen coordinates to simulation coordinates
-    const int scale_y = m_screen_height / m_height;
-    const int scale_x = m_screen_width / m_width;
-    const int sim_x = x / scale_x;
-    const int sim_y = y / scale_y;
+template <typename Storage>
+KernelRegion Fluid<Storage>::tileRegion(const int index, const int tile_size) const {
+    const int tiles_x = (m_width + tile_size - 1) / tile_size;
+    const int tx = index % tiles_x;
+    const int ty = index / tiles_x;
+    return {tx * tile_size, std::min((tx + 1) * tile_size, m_width),
+            ty * tile_size, std::min((ty + 1) * tile_size, m_height)};
+}
 
-    // Add a splash pattern
-    for (int i = -1; i <= 1; i++) {
-        for (int j = -1; j <= 1; j++) {
-            if (sim_x + i >= 0 && sim_x + i < m_width &&
-                sim_y + j >= 0 && sim_y + j < m_height) {
-                const int r = 1 + i*i + j*j;  // Distance from center
-                m_V[transform_idx(sim_x + i, sim_y + j)] = 20000.0f / r;
+template <typename Storage>
+void Fluid<Storage>::advanceBlocked(int substeps, const Compute damp, const Compute c_squared_over_s_squared) {
+    // Tiles read the current state and write the next one, so neighbours never see a
+    // tile that has already moved ahead
+    if (m_H_next.size() != m_H.size()) {
+        m_H_next = m_H;
+        m_V_next = m_V;
+    }
+    m_block_scratch.resize(m_threads);
+
+    const int tiles_x = (m_width + m_block_tile - 1) / m_block_tile;
+    const int tiles_y = (m_height + m_block_tile - 1) / m_block_tile;
+    const int tiles = tiles_x * tiles_y;
+
+    for (int done = 0; done < substeps;) {
+        const int depth = std::min(substeps - done, m_block_depth);
+
+        parallel([&](const int worker, const int workers) {
+            for (int i = worker; i < tiles; i += workers) {
+                advanceTile(tileRegion(i, m_block_tile), depth, done, m_block_scratch[worker],
+                            damp, c_squared_over_s_squared);
             }
-        }
+        });
+
+        std::swap(m_H, m_H_next);
+        std::swap(m_V, m_V_next);
+        done += depth;
     }
 }
 
-float Fluid::constrain(const float value,const float min,const float max,const float newMin,const float newMax) {
-    const float mapped = newMin + (value - min) * (newMax - newMin) / (max - min);
-    return std::max(newMin, std::min(mapped, newMax));
+template <typename Storage>
+void Fluid<Storage>::advanceTile(const KernelRegion& tile, const int depth, const int first_substep, TileScratch& scratch,
+                        const Compute damp, const Compute c_squared_over_s_squared) {
+    WAVESIM_ZONE("advanceTile");
+
+    // Footprint the tile depends on `depth` steps back, clipped to the grid
+    const int x0 = std::max(tile.x_begin - depth, 0);
+    const int x1 = std::min(tile.x_end + depth, m_width);
+    const int y0 = std::max(tile.y_begin - depth, 0);
+    const int y1 = std::min(tile.y_end + depth, m_height);
+
+    // Local copy of the footprint plus a one-cell border, which is the ghost border at grid edges
+    const int stride = x1 - x0 + 2;
+    const int rows = y1 - y0 + 2;
+    const size_t area = static_cast<size_t>(stride) * rows;
+    if (scratch.cells.size() < 2 * area) {
+        scratch.cells.resize(2 * area);
+    }
+    Storage* h = scratch.cells.data();
+    Storage* v = h + area;
+    scratch.wet.assign(area, false);
+
+    for (int row = 0; row < rows; row++) {
+        const int src = transform_idx(x0 - 1, y0 - 1 + row);
+        std::copy_n(&m_H[src], stride, h + row * stride);
+        std::copy_n(&m_V[src], stride, v + row * stride);
+        scratch.wet.copy(row * stride, m_Wet.data(), src, stride);
+    }
+
+    const Grid local = {h + stride + 1, v + stride + 1, scratch.wet.data(), m_width, m_height, stride, x0, y0};
+
+    // Each step the cells that can still be computed exactly shrink by one towards the tile
+    for (int t = 1; t <= depth; t++) {
+        const KernelRegion region = {
+            std::max(tile.x_begin - depth + t, 0) - x0, std::min(tile.x_end + depth - t, m_width) - x0,
+            std::max(tile.y_begin - depth + t, 0) - y0, std::min(tile.y_end + depth - t, m_height) - y0
+        };
+        stepBand(local, region, damp, c_squared_over_s_squared, false, first_substep + t - 1);
+
+        // The tile itself is exact after every step, so its probes can be read from the copy
+        const KernelRegion own = {tile.x_begin - x0, tile.x_end - x0, tile.y_begin - y0, tile.y_end - y0};
+        sampleProbes(local, own, first_substep + t - 1);
+    }
+
+    const int tile_width = tile.x_end - tile.x_begin;
+    for (int y = tile.y_begin; y < tile.y_end; y++) {
+        const int src = (y - y0) * stride + (tile.x_begin - x0);
+        const int dst = transform_idx(tile.x_begin, y);
+        std::copy_n(local.H + src, tile_width, &m_H_next[dst]);
+        std::copy_n(local.V + src, tile_width, &m_V_next[dst]);
+    }
 }
 
-void Fluid::render(const Renderer* renderer) {
-    const int scale_y = m_screen_height / m_height;
-    const int scale_x = m_screen_width / m_width;
+template <typename Storage>
+void Fluid<Storage>::advanceSparse(const int substeps, const Compute damp, const Compute c_squared_over_s_squared) {
+    const int tiles_x = (m_width + m_sparse_tile - 1) / m_sparse_tile;
+    const int tiles_y = (m_height + m_sparse_tile - 1) / m_sparse_tile;
+    if (m_tile_quiet.size() != static_cast<size_t>(tiles_x * tiles_y)) {
+        // Nothing is known about the current state yet, so every tile starts active
+        m_tile_quiet.assign(tiles_x * tiles_y, 0);
+        m_tile_list.reserve(tiles_x * tiles_y);
+    }
 
-    for (int y = 0; y < m_height; y++) {
-        for (int x = 0; x < m_width; x++) {
-            const int idx = transform_idx(x, y);
-            const float wet = m_Wet[idx];
-            const float height = m_H[idx];
+    const Grid g = grid();
+
+    parallel([&](const int worker, const int workers) {
+        for (int i = 0; i < substeps; i++) {
+            if (worker == 0) {
+                m_boundaries.fill_halo(g, {0, m_width, 0, m_height});
+                collectActiveTiles(tiles_x, tiles_y);
+            }
+            barrier();
+
+            // One zone per worker and sweep, not per tile
+            const int count = static_cast<int>(m_tile_list.size());
+            {
+                WAVESIM_ZONE("sparseVelocities");
+                for (int k = worker; k < count; k += workers) {
+                    const int tile = m_tile_list[k];
+                    const KernelRegion region = tileRegion(tile, m_sparse_tile);
+                    updateVelocities(g, region, damp, c_squared_over_s_squared, i);
+                    applyBoundaryConditions(g, region, i);
 
-            const SDL_Color color = calculateColor(wet, height);
-            renderer->drawRectangle(x * scale_x, y * scale_y, scale_x, scale_y, color);
+                    // A tile is still once its velocities stayed below the threshold for two steps:
+                    // zero velocity twice in a row means the heights are balanced as well
+                    const bool moving = maxAbsVelocity(g, region) > m_sparse_threshold;
+                    m_tile_quiet[tile] = moving ? 0 : std::min(m_tile_quiet[tile] + 1, 2);
+                }
+            }
+            barrier();
+
+            {
+                WAVESIM_ZONE("sparseHeights");
+                for (int k = worker; k < count; k += workers) {
+                    updateHeights(g, tileRegion(m_tile_list[k], m_sparse_tile));
+                }
+            }
+            barrier();
+
+            // Nothing writes the grid again until every worker has passed the next substep's first barrier
+            if (worker == 0) {
+                sampleProbes(g, {0, m_width, 0, m_height}, i);
+            }
+        }
+    });
+}
+
+template <typename Storage>
+void Fluid<Storage>::collectActiveTiles(const int tiles_x, const int tiles_y) {
+    WAVESIM_ZONE("collectActiveTiles");
+
+    // Waves travel at most one cell per step (dt*c < s), so a still tile can only be
+    // disturbed by its direct neighbours; step every tile within one ring of an active one.
+    // Periodic edges make tiles on opposite sides neighbours, and wave makers never rest.
+    const bool wrap_x = m_boundaries.periodic_x();
+    const bool wrap_y = m_boundaries.periodic_y();
+    m_tile_list.clear();
+    for (int ty = 0; ty < tiles_y; ty++) {
+        for (int tx = 0; tx < tiles_x; tx++) {
+            // The layer's fields are double buffered, so layer tiles must be stepped every time
+            bool near_active = m_layer.overlaps(tileRegion(ty * tiles_x + tx, m_sparse_tile)) ||
+                               (tx == 0 && m_boundaries.kind(Edge::Left) == BoundaryKind::WaveMaker) ||
+                               (tx == tiles_x - 1 && m_boundaries.kind(Edge::Right) == BoundaryKind::WaveMaker) ||
+                               (ty == 0 && m_boundaries.kind(Edge::Top) == BoundaryKind::WaveMaker) ||
+                               (ty == tiles_y - 1 && m_boundaries.kind(Edge::Bottom) == BoundaryKind::WaveMaker);
+            for (int dy = -1; dy <= 1; dy++) {
+                int ny = ty + dy;
+                if (wrap_y) {
+                    ny = (ny + tiles_y) % tiles_y;
+                } else if (ny < 0 || ny >= tiles_y) {
+                    continue;
+                }
+                for (int dx = -1; dx <= 1; dx++) {
+                    int nx = tx + dx;
+                    if (wrap_x) {
+                        nx = (nx + tiles_x) % tiles_x;
+                    } else if (nx < 0 || nx >= tiles_x) {
+                        continue;
+                    }
+                    near_active |= m_tile_quiet[ny * tiles_x + nx] < 2;
+                }
+            }
+            if (near_active) {
+                m_tile_list.push_back(ty * tiles_x + tx);
+            }
         }
     }
+    m_active_fraction = static_cast<float>(m_tile_list.size()) / static_cast<float>(tiles_x * tiles_y);
 }
 
-SDL_Color Fluid::calculateColor(const float wet,const float height) {
-    SDL_Color color = {0, 0, 0, 150};
+template <typename Storage>
+float Fluid<Storage>::maxAbsVelocity(const Grid& grid, const KernelRegion& region) const {
+    float motion = 0.0f;
+    for (int y = region.y_begin; y < region.y_end; y++) {
+        const Storage* v = grid.V + y * grid.stride;
+        for (int x = region.x_begin; x < region.x_end; x++) {
+            motion = std::max(motion, std::abs(precision_cast<float>(v[x])));
+        }
+    }
+    return motion;
+}
 
-    if (wet == 0.0f) {
-        // Obstacle color
-        color.r = 255;
-        color.g = 255;
-        color.b = 255;
-    } else {
-        // Water color based on height
-        color.r = 45;
-        color.g = 35;
-        // Map height to blue intensity
-        const float blue = 128.0f * (height + 1.0f);
-        color.b = std::clamp(blue, 0.0f, 255.0f);
+template <typename Storage>
+void Fluid<Storage>::updateVelocities(const Grid& grid, const KernelRegion& region, const Compute damp,
+                                      const Compute c_squared_over_s_squared, const int substep) {
+    const auto update_rows = [&](const KernelRegion& rows, const bool porous) {
+        if (m_medium_speed.empty() && !porous) {
+            m_kernels->update_velocities(grid, rows, damp, m_dt, c_squared_over_s_squared, m_snap_epsilon);
+            return;
+        }
+        const BasicMediumFields<Storage> medium = {
+            m_medium_damping.empty() ? nullptr : m_medium_damping.data(),
+            m_medium_speed.empty() ? nullptr : m_medium_speed.data(),
+            porous ? m_porosity.data() : nullptr, m_width, m_stride};
+        m_kernels->update_velocities_medium(grid, rows, medium, damp, m_dt, c_squared_over_s_squared, m_snap_epsilon);
+    };
+    const auto update = [&](const KernelRegion& part) {
+        if (m_porosity.empty()) {
+            update_rows(part, false);
+            return;
+        }
+        // Faces away from porous cells all weigh 1, so only runs of rows near them read porosity
+        for (int y = part.y_begin; y < part.y_end;) {
+            const bool porous = porousRow(y + grid.y_offset);
+            int end = y + 1;
+            while (end < part.y_end && porousRow(end + grid.y_offset) == porous) {
+                end++;
+            }
+            update_rows({part.x_begin, part.x_end, y, end}, porous);
+            y = end;
+        }
+    };
+    if (!m_layer.active()) {
+        update(region);
+        return;
     }
 
-    return color;
+    // Only whole-grid views reach here; temporal blocking steps like Fused while a layer is set
+    const auto fields = m_layer.fields(m_batch_start + substep);
+    m_layer.for_each_part(region, [&](const KernelRegion& part, const bool in_layer) {
+        if (in_layer) {
+            m_kernels->update_velocities_pml(grid, part, fields, damp, m_dt, c_squared_over_s_squared, m_snap_epsilon);
+        } else {
+            update(part);
+        }
+    });
+}
+
+template <typename Storage>
+void Fluid<Storage>::applyBoundaryConditions(const Grid& grid, const KernelRegion& region, const int substep) {
+    const double time = static_cast<double>(m_batch_start + substep + 1) * static_cast<double>(m_dt);
+    m_boundaries.apply(grid, region, m_dt, m_c / m_s, time);
+}
+
+template <typename Storage>
+void Fluid<Storage>::updateHeights(const Grid& grid, const KernelRegion& region) {
+    m_kernels->update_heights(grid, region, m_dt);
+}
+
+template <typename Storage>
+void Fluid<Storage>::generate_sierpinski_carpet(const int x,const int y,const int size,const int level,
+                                                const float porosity) {
+    paint(rasterize(Scenario::sierpinski_carpet(x, y, size, level, porosity)));
 }
 
-void Fluid::mapHeightToColor(const float height, unsigned char* r, unsigned char* g, unsigned char* b) {
-    // Normalize height for color mapping (between 0 and 1)
-    const float normHeight = (height - 1.0f) / (10.0f - 1.0f);
+template <typename Storage>
+bool Fluid<Storage>::load_scenario(const Scenario& scenario, const std::string& cache_dir) {
+    WAVESIM_ZONE("load_scenario");
+    const uint64_t key = scenario.hash(m_width, m_height);
+    std::string cache_path;
+    if (!cache_dir.empty()) {
+        char name[32];
+        std::snprintf(name, sizeof(name), "%016llx.wsmap", static_cast<unsigned long long>(key));
+        cache_path = cache_dir + "/" + name;
+    }
+
+    MaterialMap map;
+    const bool cached = !cache_path.empty() && map.load(cache_path, key);
+    if (!cached) {
+        map = rasterize(scenario);
+        if (!cache_path.empty() && !map.save(cache_path, key)) {
+            std::cerr << "Could not write scenario cache " << cache_path << std::endl;
+        }
+    }
+
+    clear_obstacles();
+    m_medium_speed.clear();
+    m_medium_damping.clear();
+    paint(map);
+    return cached;
+}
 
-    // Blue for low heights, red for high heights
-    *r = static_cast<unsigned char>(255.0f * normHeight);                // Red increases with height
-    *g = static_cast<unsigned char>(std::max(0.0f, 255.0f * (1.0f - 2.0f * std::abs(normHeight - 0.5f)))); // Green peaks in middle
-    *b = static_cast<unsigned char>(255.0f * (1.0f - normHeight));       // Blue decreases with height
+template <typename Storage>
+MaterialMap Fluid<Storage>::rasterize(const Scenario& scenario) {
+    WAVESIM_ZONE("rasterize");
+    MaterialMap map = scenario.map(m_width, m_height);
+    parallel([&](const int worker, const int workers) {
+        const KernelRegion band = rowBand(worker, workers);
+        scenario.rasterize(map, band.y_begin, band.y_end);
+    });
+    return map;
 }
 
-void Fluid::plot_waves() {
-    while (true) {
-        std::vector<unsigned char> image_data(m_height * m_width * 3);  // RGB values
+template <typename Storage>
+void Fluid<Storage>::paint(const MaterialMap& map) {
+    if (map.width != m_width || map.height != m_height) {
+        std::cerr << "Material map of " << map.width << " x " << map.height << " does not fit the grid" << std::endl;
+        exit(1);
+    }
 
-        // Generate height-mapped image
-        for (int x = 1; x < m_height - 1; x++) {
-            for (int y = 1; y < m_width - 1; y++) {
-                const int idx = transform_idx(x, y);
-                const float height = m_H[idx];
+    // Stored values of each material, judged as stored like setPorosity does
+    struct Stored {
+        Storage porosity;
+        Storage speed_squared;
+        Storage damping;
+        bool wet;
+        bool porous;
+    };
+    std::vector<Stored> stored;
+    bool any_porous = false;
+    bool any_medium = false;
+    for (size_t i = 1; i < map.materials.size(); i++) {
+        const Material& material = map.materials[i];
+        const Storage porosity = precision_cast<Storage>(material.porosity);
+        const float kept = precision_cast<float>(porosity);
+        stored.push_back({porosity, precision_cast<Storage>(material.speed * material.speed),
+                          precision_cast<Storage>(std::exp(-material.damping_rate * m_dt)), kept > 0.0f,
+                          kept > 0.0f && kept < 1.0f});
+        any_porous |= stored.back().porous;
+        any_medium |= material.speed != 1.0f || material.damping_rate != 0.0f;
+    }
+    if (any_porous && m_porosity.empty()) {
+        m_porosity.assign(m_H.size(), precision_cast<Storage>(1.0f));
+        m_porous_rows.assign(m_height, 0);
+    }
+    if (any_medium && m_medium_speed.empty()) {
+        const size_t cells = static_cast<size_t>(m_width) * m_height;
+        m_medium_speed.assign(cells, precision_cast<Storage>(1.0f));
+        m_medium_damping.assign(cells, precision_cast<Storage>(1.0f));
+    }
 
-                // Calculate pixel color
-                int pixel_idx = (x * m_height + y) * 3;
-                mapHeightToColor(height,
-                                 &image_data[pixel_idx],
-                                 &image_data[pixel_idx + 1],
-                                 &image_data[pixel_idx + 2]);
+    for (int y = 0; y < m_height; y++) {
+        int x = 0;
+        for (const MaterialMap::Run& run : map.rows[y]) {
+            const int begin = x;
+            x = run.end;
+            if (run.material == 0) {
+                continue;
+            }
+            const Stored& material = stored[run.material - 1];
+            const int first = transform_idx(begin, y);
+            const int count = run.end - begin;
+            if (!m_porosity.empty()) {
+                int change = material.porous ? count : 0;
+                if (m_porous_rows[y] > 0) {
+                    for (int i = first; i < first + count; i++) {
+                        change -= m_Wet.test(i) && precision_cast<float>(m_porosity[i]) < 1.0f;
+                    }
+                }
+                std::fill_n(m_porosity.begin() + first, count, material.porosity);
+                m_porous_cells += change;
+                m_porous_rows[y] += change;
+            }
+            m_Wet.fill(first, count, material.wet);
+            if (!m_medium_speed.empty()) {
+                const size_t cell = static_cast<size_t>(y) * m_width + begin;
+                std::fill_n(m_medium_speed.begin() + cell, count, material.speed_squared);
+                std::fill_n(m_medium_damping.begin() + cell, count, material.damping);
             }
         }
+    }
+    if (!m_porosity.empty() && m_porous_cells == 0) {
+        m_porosity.clear();
+        m_porous_rows.clear();
+    }
+    m_tile_quiet.clear();
+}
 
-        // Render the image
-        plt::imshow(image_data.data(), m_height, m_width, 3);
-        plt::pause(0.05);  // Pause for smooth update
+template <typename Storage>
+void Fluid<Storage>::add_velocity(int x, int y, const float strength) {
+    // Convert screen coordinates to simulation coordinates
+    const int scale_y = m_screen_height / m_height;
+    const int scale_x = m_screen_width / m_width;
+    const int sim_x = x / scale_x;
+    const int sim_y = y / scale_y;
+
+    // Add a splash pattern
+    for (int i = -1; i <= 1; i++) {
+        for (int j = -1; j <= 1; j++) {
+            if (sim_x + i >= 0 && sim_x + i < m_width &&
+                sim_y + j >= 0 && sim_y + j < m_height) {
+                const int r = 1 + i*i + j*j;  // Distance from center
+                m_V[transform_idx(sim_x + i, sim_y + j)] = precision_cast<Storage>(strength / r);
+                wakeTile(sim_x + i, sim_y + j);
+            }
+        }
+    }
+}
+
+template <typename Storage>
+void Fluid<Storage>::wakeEdges() {
+    // A new condition can set still edge water moving
+    for (int x = 0; x < m_width; x++) {
+        wakeTile(x, 0);
+        wakeTile(x, m_height - 1);
     }
+    for (int y = 0; y < m_height; y++) {
+        wakeTile(0, y);
+        wakeTile(m_width - 1, y);
+    }
+}
+
+template <typename Storage>
+void Fluid<Storage>::wakeTile(const int x, const int y) {
+    if (m_tile_quiet.empty()) {
+        return;
+    }
+    const int tiles_x = (m_width + m_sparse_tile - 1) / m_sparse_tile;
+    m_tile_quiet[(y / m_sparse_tile) * tiles_x + x / m_sparse_tile] = 0;
+}
+
+template <typename Storage>
+float Fluid<Storage>::constrain(const float value,const float min,const float max,const float newMin,const float newMax) {
+    const float mapped = newMin + (value - min) * (newMax - newMin) / (max - min);
+    return std::max(newMin, std::min(mapped, newMax));
 }
 
+template class Fluid<float>;
+template class Fluid<double>;
+template class Fluid<Half>;
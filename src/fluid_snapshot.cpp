@@ -0,0 +1,48 @@
+#include "../include/fluid_snapshot.h"
+
+template <typename Storage>
+double FluidSnapshot<Storage>::sim_time() const {
+    return m_time;
+}
+
+template <typename Storage>
+uint64_t FluidSnapshot<Storage>::step_count() const {
+    return m_steps;
+}
+
+template <typename Storage>
+int FluidSnapshot<Storage>::width() const {
+    return m_width;
+}
+
+template <typename Storage>
+int FluidSnapshot<Storage>::height() const {
+    return m_height;
+}
+
+template <typename Storage>
+int FluidSnapshot<Storage>::transform_idx(const int x, const int y) const {
+    return (y + 1) * m_stride + (x + 1);
+}
+
+template <typename Storage>
+double FluidSnapshot<Storage>::height_at(const int x, const int y) const {
+    return precision_cast<double>(m_H[transform_idx(x, y)]);
+}
+
+template <typename Storage>
+bool FluidSnapshot<Storage>::is_wet(const int x, const int y) const {
+    return m_Wet.test(transform_idx(x, y));
+}
+
+template <typename Storage>
+void FluidSnapshot<Storage>::map_colors(const ColorLut& lut, uint32_t* pixels, const int pitch) const {
+    const int origin = transform_idx(0, 0);
+    const BasicFluidGrid<Storage> view = {const_cast<Storage*>(&m_H[origin]), nullptr, m_Wet.data(),
+                                          m_width, m_height, m_stride, 0, 0};
+    m_kernels->map_colors(view, {0, m_width, 0, m_height}, lut, pixels, pitch);
+}
+
+template class FluidSnapshot<float>;
+template class FluidSnapshot<double>;
+template class FluidSnapshot<Half>;
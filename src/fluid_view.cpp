@@ -0,0 +1,51 @@
+#include "../include/fluid_view.h"
+#include "../include/profiler.h"
+
+#include <algorithm>
+#include <cstring>
+
+FluidView::FluidView(const Palette palette)
+    : m_colormap(palette), m_frame_height(0), m_frame_width(0)
+{
+}
+
+void FluidView::render(const FluidSnapshot<>& snapshot, Renderer* renderer) {
+    WAVESIM_ZONE("render");
+    const int height = snapshot.height();
+    const int width = snapshot.width();
+    if (height != m_frame_height || width != m_frame_width) {
+        renderer->createFrame(width, height);
+        m_frame_height = height;
+        m_frame_width = width;
+    }
+
+    int pitch = 0;
+    unsigned char* pixels = renderer->lockFrame(&pitch);
+    snapshot.map_colors(m_colormap.lut(), reinterpret_cast<uint32_t*>(pixels), pitch / static_cast<int>(sizeof(uint32_t)));
+    renderer->unlockFrame();
+    renderer->drawFrame();
+}
+
+void FluidView::render_rectangles(const FluidSnapshot<>& snapshot, Renderer* renderer, const int cell_width,
+                                  const int cell_height) const {
+    WAVESIM_ZONE("render_rectangles");
+    const ColorLut& lut = m_colormap.lut();
+    for (int y = 0; y < snapshot.height(); y++) {
+        for (int x = 0; x < snapshot.width(); x++) {
+            // Same lookup as the map_colors kernels
+            int index = lut.levels;
+            if (snapshot.is_wet(x, y)) {
+                const float scaled = (static_cast<float>(snapshot.height_at(x, y)) - lut.offset) * lut.scale;
+                index = static_cast<int>(std::min(std::max(scaled, 0.0f), static_cast<float>(lut.levels - 1)));
+            }
+            SDL_Color color;
+            std::memcpy(&color, &lut.colors[index], sizeof(color));
+            renderer->drawRectangle(x * cell_width, y * cell_height, cell_width, cell_height, color);
+        }
+    }
+}
+
+void FluidView::cycle_palette() {
+    const int next = (static_cast<int>(m_colormap.palette()) + 1) % static_cast<int>(Palette::Count);
+    m_colormap.set_palette(static_cast<Palette>(next));
+}
@@ -0,0 +1,99 @@
+#include "../include/frame_scheduler.h"
+
+#include <algorithm>
+#include <iostream>
+#include <thread>
+
+namespace {
+    // Measurement window for the reported rates
+    constexpr std::chrono::milliseconds report_window(500);
+
+    // Starting guess and upper bound for how late a sleep wakes; a longer hiccup is
+    // better missed than spun through on the frames after it
+    constexpr std::chrono::microseconds initial_sleep_slack(1000);
+    constexpr std::chrono::microseconds max_sleep_slack(2000);
+}
+
+FrameScheduler::FrameScheduler(const int fps)
+    : m_period(), m_vsync(false), m_work_cost(0.0), m_sleep_slack(initial_sleep_slack),
+      m_window_frames(0), m_window_work(Clock::duration::zero()), m_window_sim_start(0.0), m_sim_time(0.0),
+      m_fps(0.0), m_busy(0.0), m_sim_rate(0.0)
+{
+    set_target_fps(fps);
+    m_frame_start = Clock::now();
+    m_deadline = m_frame_start + m_period;
+    m_window_start = m_frame_start;
+}
+
+void FrameScheduler::set_target_fps(const int fps) {
+    if (fps <= 0) {
+        std::cerr << "Target frame rate must be positive" << std::endl;
+        exit(1);
+    }
+    m_period = std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(1.0 / fps));
+}
+
+void FrameScheduler::set_vsync(const bool vsync) {
+    m_vsync = vsync;
+}
+
+double FrameScheduler::remaining() const {
+    return std::chrono::duration<double>(m_deadline - Clock::now()).count();
+}
+
+void FrameScheduler::end_frame() {
+    Clock::time_point now = Clock::now();
+    m_window_work += now - m_frame_start;
+
+    if (!m_vsync && now < m_deadline) {
+        // Sleep for all but the lateness sleeps have shown lately, then yield through the rest
+        const Clock::time_point wake = m_deadline - m_sleep_slack;
+        if (wake > now) {
+            std::this_thread::sleep_until(wake);
+            const Clock::duration late = Clock::now() - wake;
+            m_sleep_slack = std::min<Clock::duration>(std::max<Clock::duration>(late, m_sleep_slack * 7 / 8),
+                                                      max_sleep_slack);
+        }
+        while (Clock::now() < m_deadline) {
+            std::this_thread::yield();
+        }
+        now = Clock::now();
+    }
+
+    // Keep a steady cadence, but do not try to catch up after falling more than a frame behind
+    m_deadline += m_period;
+    if (m_vsync || now > m_deadline) {
+        m_deadline = now + m_period;
+    }
+    m_frame_start = now;
+
+    m_window_frames++;
+    const Clock::duration window = now - m_window_start;
+    if (window >= report_window) {
+        const double seconds = std::chrono::duration<double>(window).count();
+        m_fps = m_window_frames / seconds;
+        m_busy = std::chrono::duration<double>(m_window_work).count() / seconds;
+        m_sim_rate = (m_sim_time - m_window_sim_start) / seconds;
+
+        m_window_start = now;
+        m_window_frames = 0;
+        m_window_work = Clock::duration::zero();
+        m_window_sim_start = m_sim_time;
+    }
+}
+
+void FrameScheduler::record_sim_time(const double seconds) {
+    m_sim_time = seconds;
+}
+
+double FrameScheduler::fps() const {
+    return m_fps;
+}
+
+double FrameScheduler::busy() const {
+    return m_busy;
+}
+
+double FrameScheduler::sim_rate() const {
+    return m_sim_rate;
+}
@@ -0,0 +1,477 @@
+// Headless batch runner: steps the default scenario without a window or Python and
+// reports throughput. Usage:
+//   wavesim_headless [--steps N] [--width W] [--height H] [--threads T]
+//                    [--mode three-pass|fused|blocked|sparse] [--kernels NAME]
+//                    [--blocking DEPTH,TILE] [--sparse-tile N]
+//                    [--precision float|double|half]
+//                    [--snapshots FILE] [--snapshot-every N] [--snapshot-downsample D]
+//                    [--probe X,Y]... [--probe-csv FILE] [--trace FILE] [--perf]
+//                    [--flush-denormals] [--snap EPSILON]
+//                    [--boundary [EDGE=]KIND]... [--wave-maker EDGE,AMPLITUDE,PERIOD]...
+//                    [--absorbing-layer [EDGE=]THICKNESS]...
+//                    [--scenario FILE] [--scenario-cache DIR]
+//
+// --blocking sets the steps per pass and tile size of the blocked mode, --sparse-tile
+// the tile size of the sparse mode. --snapshots appends raw float32 frames (row-major,
+// downsampled) to FILE from a writer thread while the simulation runs. --probe-csv
+// writes the height and velocity at every --probe cell for every substep. --trace
+// writes the profiler zones as Chrome trace JSON and prints per-zone totals; it needs
+// -DWAVESIM_PROFILING=ON. --perf counts hardware events (Linux perf_event_open) and
+// prints IPC and misses per cell update, split into sweeps in three-pass mode.
+// --flush-denormals runs the solver with flush-to-zero and --snap zeroes velocities
+// below EPSILON, so long damped runs do not slow down once the waves have decayed into
+// subnormal numbers. --boundary sets every edge, or one of left, right, top and bottom,
+// to reflective, periodic or absorbing; --wave-maker drives an edge with a sine of the
+// given height and period. --absorbing-layer puts a perfectly matched layer of
+// THICKNESS cells along every edge, or one of them; it absorbs far better than an
+// absorbing edge but takes up cells. --scenario replaces the default carpet with the
+// obstacles, porous structures and bathymetry of a scenario file (see Scenario);
+// --scenario-cache keeps the rasterized map in DIR so later runs on the same grid skip
+// rasterization.
+
+#include "../include/fluid.h"
+#include "../include/snapshot_channel.h"
+#include "../include/probe_recorder.h"
+#include "../include/profiler.h"
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+struct HeadlessConfig {
+    int steps = 4800;
+    int width = 250;
+    int height = 150;
+    int threads = 0;
+    StepMode mode = StepMode::Fused;
+    int block_depth = 16;
+    int block_tile = 256;
+    int sparse_tile = 32;
+    const char* kernels = nullptr;
+    std::string precision = "float";
+    const char* snapshot_path = nullptr;
+    int snapshot_every = 480;
+    int snapshot_downsample = 1;
+    std::vector<std::pair<int, int>> probes;
+    const char* probe_path = nullptr;
+    const char* trace_path = nullptr;
+    bool perf = false;
+    bool flush_denormals = false;
+    float snap_epsilon = 0.0f;
+    std::vector<std::pair<Edge, BoundaryKind>> boundaries;
+    struct WaveMaker {
+        Edge edge;
+        float amplitude;
+        float period;
+    };
+    std::vector<WaveMaker> wave_makers;
+    std::vector<std::pair<Edge, int>> absorbing_layers;
+    const char* scenario_path = nullptr;
+    const char* scenario_cache = nullptr;
+};
+
+static void usage(const char* program) {
+    std::fprintf(stderr,
+                 "usage: %s [--steps N] [--width W] [--height H] [--threads T]\n"
+                 "          [--mode three-pass|fused|blocked|sparse] [--kernels NAME]\n"
+                 "          [--blocking DEPTH,TILE] [--sparse-tile N]\n"
+                 "          [--precision float|double|half]\n"
+                 "          [--snapshots FILE] [--snapshot-every N] [--snapshot-downsample D]\n"
+                 "          [--probe X,Y]... [--probe-csv FILE] [--trace FILE] [--perf]\n"
+                 "          [--flush-denormals] [--snap EPSILON]\n"
+                 "          [--boundary [EDGE=]reflective|periodic|absorbing]... [--wave-maker EDGE,AMPLITUDE,PERIOD]...\n"
+                 "          [--absorbing-layer [EDGE=]THICKNESS]...\n"
+                 "          [--scenario FILE] [--scenario-cache DIR]\n",
+                 program);
+    exit(1);
+}
+
+static StepMode parseMode(const char* program, const char* name) {
+    if (std::strcmp(name, "three-pass") == 0) return StepMode::ThreePass;
+    if (std::strcmp(name, "fused") == 0) return StepMode::Fused;
+    if (std::strcmp(name, "blocked") == 0) return StepMode::TemporalBlocked;
+    if (std::strcmp(name, "sparse") == 0) return StepMode::Sparse;
+    std::fprintf(stderr, "unknown step mode: %s\n", name);
+    usage(program);
+    return StepMode::Fused;
+}
+
+static bool parseEdge(const std::string& name, Edge& edge) {
+    if (name == "left") edge = Edge::Left;
+    else if (name == "right") edge = Edge::Right;
+    else if (name == "top") edge = Edge::Top;
+    else if (name == "bottom") edge = Edge::Bottom;
+    else return false;
+    return true;
+}
+
+// "KIND" applies to every edge, "EDGE=KIND" to one
+static void parseBoundary(const char* program, const std::string& value, HeadlessConfig& config) {
+    const size_t equals = value.find('=');
+    const std::string name = equals == std::string::npos ? value : value.substr(equals + 1);
+    BoundaryKind kind;
+    if (name == "reflective") kind = BoundaryKind::Reflective;
+    else if (name == "periodic") kind = BoundaryKind::Periodic;
+    else if (name == "absorbing") kind = BoundaryKind::Absorbing;
+    else {
+        std::fprintf(stderr, "unknown boundary: %s\n", name.c_str());
+        usage(program);
+    }
+
+    if (equals == std::string::npos) {
+        for (const Edge edge : {Edge::Left, Edge::Right, Edge::Top, Edge::Bottom}) {
+            config.boundaries.emplace_back(edge, kind);
+        }
+        return;
+    }
+    Edge edge;
+    if (!parseEdge(value.substr(0, equals), edge)) {
+        std::fprintf(stderr, "unknown edge: %s\n", value.substr(0, equals).c_str());
+        usage(program);
+    }
+    config.boundaries.emplace_back(edge, kind);
+}
+
+// "THICKNESS" applies to every edge, "EDGE=THICKNESS" to one
+static void parseAbsorbingLayer(const char* program, const std::string& value, HeadlessConfig& config) {
+    const size_t equals = value.find('=');
+    const int thickness = std::atoi(value.c_str() + (equals == std::string::npos ? 0 : equals + 1));
+    if (thickness < 0) {
+        usage(program);
+    }
+
+    if (equals == std::string::npos) {
+        for (const Edge edge : {Edge::Left, Edge::Right, Edge::Top, Edge::Bottom}) {
+            config.absorbing_layers.emplace_back(edge, thickness);
+        }
+        return;
+    }
+    Edge edge;
+    if (!parseEdge(value.substr(0, equals), edge)) {
+        std::fprintf(stderr, "unknown edge: %s\n", value.substr(0, equals).c_str());
+        usage(program);
+    }
+    config.absorbing_layers.emplace_back(edge, thickness);
+}
+
+static HeadlessConfig parseArgs(const int argc, char* argv[]) {
+    HeadlessConfig config;
+    for (int i = 1; i < argc; i++) {
+        if (std::strcmp(argv[i], "--perf") == 0) {
+            config.perf = true;
+            continue;
+        }
+        if (std::strcmp(argv[i], "--flush-denormals") == 0) {
+            config.flush_denormals = true;
+            continue;
+        }
+        if (i + 1 >= argc) {
+            usage(argv[0]);
+        }
+        const char* option = argv[i];
+        const char* value = argv[++i];
+        if (std::strcmp(option, "--steps") == 0) {
+            config.steps = std::atoi(value);
+        } else if (std::strcmp(option, "--width") == 0) {
+            config.width = std::atoi(value);
+        } else if (std::strcmp(option, "--height") == 0) {
+            config.height = std::atoi(value);
+        } else if (std::strcmp(option, "--threads") == 0) {
+            config.threads = std::atoi(value);
+        } else if (std::strcmp(option, "--mode") == 0) {
+            config.mode = parseMode(argv[0], value);
+        } else if (std::strcmp(option, "--blocking") == 0) {
+            if (std::sscanf(value, "%d,%d", &config.block_depth, &config.block_tile) != 2) {
+                usage(argv[0]);
+            }
+        } else if (std::strcmp(option, "--sparse-tile") == 0) {
+            config.sparse_tile = std::atoi(value);
+        } else if (std::strcmp(option, "--kernels") == 0) {
+            config.kernels = value;
+        } else if (std::strcmp(option, "--precision") == 0) {
+            config.precision = value;
+        } else if (std::strcmp(option, "--snapshots") == 0) {
+            config.snapshot_path = value;
+        } else if (std::strcmp(option, "--snapshot-every") == 0) {
+            config.snapshot_every = std::atoi(value);
+        } else if (std::strcmp(option, "--snapshot-downsample") == 0) {
+            config.snapshot_downsample = std::atoi(value);
+        } else if (std::strcmp(option, "--probe") == 0) {
+            int x = 0;
+            int y = 0;
+            if (std::sscanf(value, "%d,%d", &x, &y) != 2) {
+                usage(argv[0]);
+            }
+            config.probes.emplace_back(x, y);
+        } else if (std::strcmp(option, "--probe-csv") == 0) {
+            config.probe_path = value;
+        } else if (std::strcmp(option, "--trace") == 0) {
+            config.trace_path = value;
+        } else if (std::strcmp(option, "--boundary") == 0) {
+            parseBoundary(argv[0], value, config);
+        } else if (std::strcmp(option, "--wave-maker") == 0) {
+            char edge_name[16];
+            HeadlessConfig::WaveMaker maker;
+            if (std::sscanf(value, "%15[a-z],%f,%f", edge_name, &maker.amplitude, &maker.period) != 3 ||
+                !parseEdge(edge_name, maker.edge) || !(maker.period > 0.0f)) {
+                usage(argv[0]);
+            }
+            config.wave_makers.push_back(maker);
+        } else if (std::strcmp(option, "--absorbing-layer") == 0) {
+            parseAbsorbingLayer(argv[0], value, config);
+        } else if (std::strcmp(option, "--scenario") == 0) {
+            config.scenario_path = value;
+        } else if (std::strcmp(option, "--scenario-cache") == 0) {
+            config.scenario_cache = value;
+        } else if (std::strcmp(option, "--snap") == 0) {
+            config.snap_epsilon = static_cast<float>(std::atof(value));
+        } else {
+            usage(argv[0]);
+        }
+    }
+    if (config.steps <= 0 || config.width <= 0 || config.height <= 0 || config.threads < 0 ||
+        config.block_depth <= 0 || config.block_tile <= 0 || config.sparse_tile <= 0 ||
+        config.snapshot_every <= 0 || config.snapshot_downsample <= 0 || config.snap_epsilon < 0.0f ||
+        (config.probe_path != nullptr && config.probes.empty()) ||
+        (config.scenario_cache != nullptr && config.scenario_path == nullptr)) {
+        usage(argv[0]);
+    }
+    return config;
+}
+
+// Drains a snapshot channel into a file until the simulation is done and the ring is empty
+static void writeSnapshots(SnapshotChannel& channel, std::FILE* file, const std::atomic<bool>& simulating,
+                           uint64_t* written) {
+    const size_t values = static_cast<size_t>(channel.width()) * channel.height();
+    while (true) {
+        const bool done = !simulating.load();
+        while (const SnapshotFrame* frame = channel.read()) {
+            std::fwrite(frame->heights.data(), sizeof(float), values, file);
+            channel.release();
+            (*written)++;
+        }
+        if (done) {
+            return;
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+}
+
+// Drains probe records into a CSV file until the simulation is done and the ring is empty
+static void writeProbes(ProbeRecorder& recorder, std::FILE* file, const double dt,
+                        const std::atomic<bool>& simulating) {
+    std::fprintf(file, "step,time");
+    for (int k = 0; k < recorder.probes(); k++) {
+        std::fprintf(file, ",h%d", k);
+    }
+    for (int k = 0; k < recorder.probes(); k++) {
+        std::fprintf(file, ",v%d", k);
+    }
+    std::fprintf(file, "\n");
+
+    const auto write = [&](const uint64_t step, const float* heights, const float* velocities) {
+        std::fprintf(file, "%llu,%.9g", static_cast<unsigned long long>(step), step * dt);
+        for (int k = 0; k < recorder.probes(); k++) {
+            std::fprintf(file, ",%.9g", heights[k]);
+        }
+        for (int k = 0; k < recorder.probes(); k++) {
+            std::fprintf(file, ",%.9g", velocities[k]);
+        }
+        std::fprintf(file, "\n");
+    };
+
+    while (true) {
+        const bool done = !simulating.load();
+        recorder.drain(write);
+        if (done) {
+            return;
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+}
+
+// Print IPC and events per cell update for every phase that was counted
+template <typename Storage>
+static void printPerf(const Fluid<Storage>& fluid, const double cell_updates) {
+    static const char* const phases[] = {"step", "velocities", "boundaries", "heights"};
+    std::printf("perf phase    %12s %8s %14s %14s %14s\n", "cycles/cell", "IPC", "L1D miss/cell", "LLC miss/cell",
+                "br miss/cell");
+    for (int phase = 0; phase < static_cast<int>(PerfPhase::Count); phase++) {
+        const PerfSample counts = fluid.perf_counts(static_cast<PerfPhase>(phase));
+        if (counts[PerfEvent::Cycles] == 0) {
+            continue;
+        }
+        std::printf("  %-11s %12.3f %8.3f %14.4f %14.4f %14.4f\n", phases[phase],
+                    counts[PerfEvent::Cycles] / cell_updates,
+                    static_cast<double>(counts[PerfEvent::Instructions]) / counts[PerfEvent::Cycles],
+                    counts[PerfEvent::L1dReadMisses] / cell_updates, counts[PerfEvent::LlcMisses] / cell_updates,
+                    counts[PerfEvent::BranchMisses] / cell_updates);
+    }
+}
+
+template <typename Storage>
+static void run(const HeadlessConfig& config) {
+    // Same scenario as the interactive frontend: one screen pixel per cell, two splashes
+    Fluid<Storage> fluid(config.height, config.width, 1.0f / 48000.0f, 2.0f, 0.001f,
+                         config.height, config.width);
+    fluid.set_threads(config.threads);
+    fluid.set_step_mode(config.mode);
+    fluid.set_temporal_blocking(config.block_depth, config.block_tile);
+    fluid.set_sparse_tracking(config.sparse_tile, 0.0f);
+    fluid.set_denormal_protection(config.flush_denormals, config.snap_epsilon);
+    for (const auto& [edge, kind] : config.boundaries) {
+        fluid.set_boundary(edge, kind);
+    }
+    for (const HeadlessConfig::WaveMaker& maker : config.wave_makers) {
+        fluid.set_wave_maker(maker.edge, maker.amplitude, maker.period);
+    }
+    for (const auto& [edge, thickness] : config.absorbing_layers) {
+        fluid.set_absorbing_layer(edge, thickness);
+    }
+    if (config.scenario_path != nullptr) {
+        const Scenario scenario = Scenario::load(config.scenario_path);
+        const auto load_start = std::chrono::steady_clock::now();
+        const bool cached = fluid.load_scenario(scenario, config.scenario_cache != nullptr ? config.scenario_cache : "");
+        const double load_seconds =
+            std::chrono::duration<double>(std::chrono::steady_clock::now() - load_start).count();
+        std::printf("scenario     %zu shapes, %s in %.6f s\n", scenario.shapes(),
+                    cached ? "read from cache" : "rasterized", load_seconds);
+    }
+    if (config.kernels != nullptr) {
+        if constexpr (std::is_same_v<Storage, float>) {
+            const KernelSet* set = kernels::find(config.kernels);
+            if (set == nullptr) {
+                std::fprintf(stderr, "kernel set %s is unknown or unsupported on this CPU\n", config.kernels);
+                exit(1);
+            }
+            fluid.set_kernels(*set);
+        } else {
+            std::fprintf(stderr, "--kernels only applies to float precision\n");
+            exit(1);
+        }
+    }
+    fluid.add_velocity(config.width / 10, config.height / 2);
+    fluid.add_velocity(config.width - config.width / 10, config.height / 3);
+
+    SnapshotChannel channel(config.width, config.height, config.snapshot_downsample, 64, config.snapshot_every);
+    std::FILE* snapshot_file = nullptr;
+    std::atomic<bool> simulating(true);
+    uint64_t snapshots_written = 0;
+    std::thread writer;
+    if (config.snapshot_path != nullptr) {
+        snapshot_file = std::fopen(config.snapshot_path, "wb");
+        if (snapshot_file == nullptr) {
+            std::fprintf(stderr, "could not open %s\n", config.snapshot_path);
+            exit(1);
+        }
+        fluid.add_snapshot_channel(channel);
+        writer = std::thread(writeSnapshots, std::ref(channel), snapshot_file, std::cref(simulating),
+                             &snapshots_written);
+    }
+
+    // One second of simulated time fits in the probe ring
+    const int probe_count = static_cast<int>(config.probes.size());
+    std::unique_ptr<ProbeRecorder> recorder;
+    std::FILE* probe_file = nullptr;
+    std::thread probe_writer;
+    if (config.probe_path != nullptr) {
+        probe_file = std::fopen(config.probe_path, "w");
+        if (probe_file == nullptr) {
+            std::fprintf(stderr, "could not open %s\n", config.probe_path);
+            exit(1);
+        }
+        for (const auto& [x, y] : config.probes) {
+            fluid.add_probe(x, y);
+        }
+        recorder = std::make_unique<ProbeRecorder>(probe_count, true, 48000);
+        fluid.record_probes(recorder.get());
+        probe_writer = std::thread(writeProbes, std::ref(*recorder), probe_file, fluid.dt(), std::cref(simulating));
+    }
+
+    if (config.perf && !fluid.set_perf_counters(true)) {
+        std::fprintf(stderr, "hardware counters unavailable (%s); continuing without them\n", fluid.perf_error().c_str());
+    }
+
+    constexpr float halflife = 0.7f;
+    const auto start = std::chrono::steady_clock::now();
+    fluid.advance(config.steps, halflife);
+    const auto end = std::chrono::steady_clock::now();
+
+    simulating.store(false);
+    if (writer.joinable()) {
+        writer.join();
+        std::fclose(snapshot_file);
+    }
+    if (probe_writer.joinable()) {
+        probe_writer.join();
+        std::fclose(probe_file);
+    }
+
+    const double seconds = std::chrono::duration<double>(end - start).count();
+    const double cells = static_cast<double>(config.width) * config.height * config.steps;
+    double checksum = 0.0;
+    for (int y = 0; y < config.height; y++) {
+        for (int x = 0; x < config.width; x++) {
+            checksum += fluid.height_at(x, y);
+        }
+    }
+
+    std::printf("steps        %d\n", config.steps);
+    std::printf("sim time     %.6f s\n", fluid.sim_time());
+    std::printf("wall time    %.6f s\n", seconds);
+    std::printf("steps/s      %.1f\n", config.steps / seconds);
+    std::printf("Mcell/s      %.1f\n", cells / seconds * 1e-6);
+    std::printf("checksum     %.9f\n", checksum);
+    if (config.perf && fluid.perf_error().empty()) {
+        printPerf(fluid, cells);
+    }
+    if (config.snapshot_path != nullptr) {
+        std::printf("snapshots    %llu written, %llu dropped (%d x %d floats each)\n",
+                    static_cast<unsigned long long>(snapshots_written),
+                    static_cast<unsigned long long>(channel.dropped()), channel.width(), channel.height());
+    }
+    if (recorder) {
+        std::printf("probe samples %d probes x %llu steps, %llu dropped\n", probe_count,
+                    static_cast<unsigned long long>(fluid.step_count() - recorder->dropped()),
+                    static_cast<unsigned long long>(recorder->dropped()));
+    }
+
+    if (config.trace_path != nullptr) {
+        std::ofstream trace(config.trace_path);
+        if (!trace) {
+            std::fprintf(stderr, "could not open %s\n", config.trace_path);
+            exit(1);
+        }
+        profiler::write_chrome_trace(trace);
+        std::fflush(stdout);
+        profiler::print_zone_stats(std::cout);
+    }
+}
+
+int main(int argc, char* argv[])
+{
+    const HeadlessConfig config = parseArgs(argc, argv);
+    profiler::set_thread_name("main");
+
+    if (config.precision == "float") {
+        run<float>(config);
+    } else if (config.precision == "double") {
+        run<double>(config);
+    } else if (config.precision == "half") {
+        run<Half>(config);
+    } else {
+        std::fprintf(stderr, "unknown precision: %s\n", config.precision.c_str());
+        usage(argv[0]);
+    }
+    return 0;
+}
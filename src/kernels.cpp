@@ -0,0 +1,92 @@
+#include "../include/kernels.h"
+
+#include <cstring>
+
+#if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+#include <immintrin.h>
+#include <intrin.h>
+#endif
+
+namespace {
+    // Instruction sets the kernel flavours need. Queried from the CPU directly so the
+    // core library does not depend on SDL.
+    struct CpuFeatures {
+        bool sse2;
+        bool avx2;
+        bool f16c;
+        bool avx512f;
+    };
+
+    CpuFeatures detectCpuFeatures() {
+        CpuFeatures features = {false, false, false, false};
+#if (defined(__GNUC__) || defined(__clang__)) && (defined(__x86_64__) || defined(__i386__))
+        __builtin_cpu_init();
+        features.sse2 = __builtin_cpu_supports("sse2");
+        features.avx2 = __builtin_cpu_supports("avx2");
+        features.f16c = __builtin_cpu_supports("f16c");
+        features.avx512f = __builtin_cpu_supports("avx512f");
+#elif defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+        int regs[4];
+        __cpuid(regs, 0);
+        const int max_leaf = regs[0];
+        __cpuid(regs, 1);
+        features.sse2 = (regs[3] >> 26) & 1;
+        const bool osxsave = (regs[2] >> 27) & 1;
+        const bool avx = (regs[2] >> 28) & 1;
+        // The OS must save the YMM (and for AVX-512 the ZMM) registers on context switch
+        const unsigned long long xcr0 = osxsave ? _xgetbv(0) : 0;
+        const bool ymm_state = (xcr0 & 0x6) == 0x6;
+        const bool zmm_state = (xcr0 & 0xe6) == 0xe6;
+        features.f16c = avx && ymm_state && ((regs[2] >> 29) & 1);
+        if (max_leaf >= 7) {
+            __cpuidex(regs, 7, 0);
+            features.avx2 = avx && ymm_state && ((regs[1] >> 5) & 1);
+            features.avx512f = zmm_state && ((regs[1] >> 16) & 1);
+        }
+#endif
+        return features;
+    }
+
+    const CpuFeatures& cpu() {
+        static const CpuFeatures features = detectCpuFeatures();
+        return features;
+    }
+}
+
+template <>
+const KernelSet& kernels::select<float>() {
+    if (const KernelSet* set = avx512(); set && cpu().avx512f) {
+        return *set;
+    }
+    if (const KernelSet* set = avx2(); set && cpu().avx2) {
+        return *set;
+    }
+    if (const KernelSet* set = sse(); set && cpu().sse2) {
+        return *set;
+    }
+    return scalar();
+}
+
+template <>
+const BasicKernelSet<double>& kernels::select<double>() {
+    return scalar_double();
+}
+
+template <>
+const BasicKernelSet<Half>& kernels::select<Half>() {
+    if (const BasicKernelSet<Half>* set = avx512_half(); set && cpu().avx512f) {
+        return *set;
+    }
+    if (const BasicKernelSet<Half>* set = avx2_half(); set && cpu().avx2 && cpu().f16c) {
+        return *set;
+    }
+    return scalar_half();
+}
+
+const KernelSet* kernels::find(const char* name) {
+    if (std::strcmp(name, "scalar") == 0) return &scalar();
+    if (std::strcmp(name, "sse") == 0 && cpu().sse2) return sse();
+    if (std::strcmp(name, "avx2") == 0 && cpu().avx2) return avx2();
+    if (std::strcmp(name, "avx512") == 0 && cpu().avx512f) return avx512();
+    return nullptr;
+}
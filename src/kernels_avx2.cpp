@@ -0,0 +1,68 @@
+#include "kernels_impl.h"
+
+#if defined(__AVX2__) && (defined(__F16C__) || defined(_MSC_VER))
+#include <immintrin.h>
+
+struct Avx2Ops {
+    using Storage = float;
+    using Compute = float;
+    using Vec = __m256;
+    static constexpr int width = 8;
+
+    static Vec load(const float* p) { return _mm256_loadu_ps(p); }
+    static void store(float* p, Vec v) { _mm256_storeu_ps(p, v); }
+    static Vec set1(float v) { return _mm256_set1_ps(v); }
+    static Vec add(Vec a, Vec b) { return _mm256_add_ps(a, b); }
+    static Vec sub(Vec a, Vec b) { return _mm256_sub_ps(a, b); }
+    static Vec mul(Vec a, Vec b) { return _mm256_mul_ps(a, b); }
+    static Vec div(Vec a, Vec b) { return _mm256_div_ps(a, b); }
+    static Vec mask(Vec v, uint64_t bits) { return _mm256_and_ps(v, _mm256_castsi256_ps(laneMask(bits))); }
+    static Vec min(Vec a, Vec b) { return _mm256_min_ps(a, b); }
+    static Vec max(Vec a, Vec b) { return _mm256_max_ps(a, b); }
+    static Vec snap(Vec v, Vec epsilon) {
+        const __m256 small = _mm256_cmp_ps(_mm256_andnot_ps(_mm256_set1_ps(-0.0f), v), epsilon, _CMP_LT_OQ);
+        return _mm256_andnot_ps(small, v);
+    }
+    static void lookup(uint32_t* out, const uint32_t* colors, Vec index, uint64_t bits, int32_t dry) {
+        const __m256i wet_index = _mm256_cvttps_epi32(index);
+        const __m256i lanes = _mm256_blendv_epi8(_mm256_set1_epi32(dry), wet_index, laneMask(bits));
+        const __m256i pixels = _mm256_i32gather_epi32(reinterpret_cast<const int*>(colors), lanes, 4);
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(out), pixels);
+    }
+
+    // All-ones in every lane whose bit is set
+    static __m256i laneMask(uint64_t bits) {
+        const __m256i lane_bits = _mm256_setr_epi32(1, 2, 4, 8, 16, 32, 64, 128);
+        const __m256i set = _mm256_and_si256(_mm256_set1_epi32(static_cast<int>(bits)), lane_bits);
+        return _mm256_cmpeq_epi32(set, lane_bits);
+    }
+};
+
+// Half-precision storage, converted with F16C which every AVX2 CPU implements
+struct Avx2HalfOps : Avx2Ops {
+    using Storage = Half;
+
+    static Vec load(const Half* p) { return _mm256_cvtph_ps(_mm_loadu_si128(reinterpret_cast<const __m128i*>(p))); }
+    static void store(Half* p, Vec v) {
+        _mm_storeu_si128(reinterpret_cast<__m128i*>(p), _mm256_cvtps_ph(v, _MM_FROUND_TO_NEAREST_INT));
+    }
+};
+
+const KernelSet* kernels::avx2() {
+    static constexpr KernelSet set = make_kernel_set<Avx2Ops>("avx2");
+    return &set;
+}
+
+const BasicKernelSet<Half>* kernels::avx2_half() {
+    static constexpr BasicKernelSet<Half> set = make_kernel_set<Avx2HalfOps>("avx2");
+    return &set;
+}
+#else
+const KernelSet* kernels::avx2() {
+    return nullptr;
+}
+
+const BasicKernelSet<Half>* kernels::avx2_half() {
+    return nullptr;
+}
+#endif
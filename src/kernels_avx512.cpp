@@ -0,0 +1,59 @@
+#include "kernels_impl.h"
+
+#if defined(__AVX512F__)
+#include <immintrin.h>
+
+struct Avx512Ops {
+    using Storage = float;
+    using Compute = float;
+    using Vec = __m512;
+    static constexpr int width = 16;
+
+    static Vec load(const float* p) { return _mm512_loadu_ps(p); }
+    static void store(float* p, Vec v) { _mm512_storeu_ps(p, v); }
+    static Vec set1(float v) { return _mm512_set1_ps(v); }
+    static Vec add(Vec a, Vec b) { return _mm512_add_ps(a, b); }
+    static Vec sub(Vec a, Vec b) { return _mm512_sub_ps(a, b); }
+    static Vec mul(Vec a, Vec b) { return _mm512_mul_ps(a, b); }
+    static Vec div(Vec a, Vec b) { return _mm512_div_ps(a, b); }
+    static Vec mask(Vec v, uint64_t bits) { return _mm512_maskz_mov_ps(static_cast<__mmask16>(bits), v); }
+    static Vec min(Vec a, Vec b) { return _mm512_min_ps(a, b); }
+    static Vec max(Vec a, Vec b) { return _mm512_max_ps(a, b); }
+    static Vec snap(Vec v, Vec epsilon) {
+        return _mm512_maskz_mov_ps(_mm512_cmp_ps_mask(_mm512_abs_ps(v), epsilon, _CMP_NLT_UQ), v);
+    }
+    static void lookup(uint32_t* out, const uint32_t* colors, Vec index, uint64_t bits, int32_t dry) {
+        const __m512i lanes = _mm512_mask_blend_epi32(static_cast<__mmask16>(bits), _mm512_set1_epi32(dry),
+                                                      _mm512_cvttps_epi32(index));
+        _mm512_storeu_si512(out, _mm512_i32gather_epi32(lanes, colors, 4));
+    }
+};
+
+// Half-precision storage, converted with the AVX-512F conversion instructions
+struct Avx512HalfOps : Avx512Ops {
+    using Storage = Half;
+
+    static Vec load(const Half* p) { return _mm512_cvtph_ps(_mm256_loadu_si256(reinterpret_cast<const __m256i*>(p))); }
+    static void store(Half* p, Vec v) {
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(p), _mm512_cvtps_ph(v, _MM_FROUND_TO_NEAREST_INT));
+    }
+};
+
+const KernelSet* kernels::avx512() {
+    static constexpr KernelSet set = make_kernel_set<Avx512Ops>("avx512");
+    return &set;
+}
+
+const BasicKernelSet<Half>* kernels::avx512_half() {
+    static constexpr BasicKernelSet<Half> set = make_kernel_set<Avx512HalfOps>("avx512");
+    return &set;
+}
+#else
+const KernelSet* kernels::avx512() {
+    return nullptr;
+}
+
+const BasicKernelSet<Half>* kernels::avx512_half() {
+    return nullptr;
+}
+#endif
@@ -0,0 +1,361 @@
+#ifndef KERNELS_IMPL_H
+#define KERNELS_IMPL_H
+
+// Shared body of the wave-equation kernels. Each kernels_<isa>.cpp includes this
+// file with its own vector traits, so every flavour runs the exact same sequence
+// of operations and stays bit-identical to the scalar reference. Kernel translation
+// units are built without floating-point contraction for the same reason.
+
+#include <cmath>
+#include "../include/kernels.h"
+#include "../include/bitmask.h"
+
+/**
+ * Vector traits for single values, used for the reference kernels and for row tails
+ */
+template <typename StorageType>
+struct ScalarOps {
+    using Storage = StorageType;
+    using Compute = typename ComputeType<Storage>::type;
+    using Vec = Compute;
+    static constexpr int width = 1;
+
+    static Vec load(const Storage* p) { return precision_cast<Compute>(*p); }
+    static void store(Storage* p, Vec v) { *p = precision_cast<Storage>(v); }
+    static Vec set1(Compute v) { return v; }
+    static Vec add(Vec a, Vec b) { return a + b; }
+    static Vec sub(Vec a, Vec b) { return a - b; }
+    static Vec mul(Vec a, Vec b) { return a * b; }
+    static Vec div(Vec a, Vec b) { return a / b; }
+    static Vec mask(Vec v, uint64_t bits) { return (bits & 1u) ? v : Compute(0); }
+    // Same operand order and NaN behaviour as the SSE/AVX min and max instructions
+    static Vec min(Vec a, Vec b) { return a < b ? a : b; }
+    static Vec max(Vec a, Vec b) { return a > b ? a : b; }
+    // Zero if |v| < epsilon; NaN is kept
+    static Vec snap(Vec v, Vec epsilon) { return std::abs(v) < epsilon ? Compute(0) : v; }
+    static void lookup(uint32_t* out, const uint32_t* colors, Vec index, uint64_t bits, int32_t dry) {
+        *out = colors[(bits & 1u) ? static_cast<int32_t>(index) : dry];
+    }
+};
+
+/**
+ * Damping and wave speed of the velocity update. The uniform specialisation holds
+ * the broadcast coefficients only, so the plain kernel does no extra loads or
+ * multiplies; the other scales them by the medium fields of one row.
+ */
+template <typename Ops, bool Uniform>
+struct CellCoefficients;
+
+template <typename Ops>
+struct CellCoefficients<Ops, true> {
+    using Vec = typename Ops::Vec;
+    Vec damp;
+    Vec c2;
+
+    static CellCoefficients row(const Vec damp, const Vec c2, const BasicMediumFields<typename Ops::Storage>*,
+                                int64_t) {
+        return {damp, c2};
+    }
+    Vec damping(int) const { return damp; }
+    Vec speed_squared(int) const { return c2; }
+};
+
+template <typename Ops>
+struct CellCoefficients<Ops, false> {
+    using Vec = typename Ops::Vec;
+    Vec damp;
+    Vec c2;
+    const typename Ops::Storage* damping_row;  // Field entries of the row's cell x = 0
+    const typename Ops::Storage* speed_row;
+
+    static CellCoefficients row(const Vec damp, const Vec c2, const BasicMediumFields<typename Ops::Storage>* medium,
+                                const int64_t offset) {
+        return {damp, c2, medium->damping + offset, medium->speed_squared + offset};
+    }
+    Vec damping(const int x) const { return Ops::mul(damp, Ops::load(damping_row + x)); }
+    Vec speed_squared(const int x) const { return Ops::mul(c2, Ops::load(speed_row + x)); }
+};
+
+/**
+ * Sum of the height differences across the four faces of a cell, in the order
+ * top, bottom, left, right. Porous faces are scaled by the smaller porosity of
+ * their two cells; the solid specialisation reads no porosity at all.
+ */
+template <typename Ops, bool Porous>
+struct CellFaces;
+
+template <typename Ops>
+struct CellFaces<Ops, false> {
+    using Vec = typename Ops::Vec;
+
+    static CellFaces row(const BasicMediumFields<typename Ops::Storage>*, int64_t) {
+        return {};
+    }
+    Vec sum(int, const Vec top, const Vec bottom, const Vec left, const Vec right) const {
+        return Ops::add(Ops::add(Ops::add(top, bottom), left), right);
+    }
+};
+
+template <typename Ops>
+struct CellFaces<Ops, true> {
+    using Vec = typename Ops::Vec;
+    const typename Ops::Storage* porosity_row;  // Porosity of the row's cell x = 0
+    int stride;
+
+    static CellFaces row(const BasicMediumFields<typename Ops::Storage>* medium, const int64_t offset) {
+        return {medium->porosity + offset, medium->stride};
+    }
+    Vec sum(const int x, const Vec top, const Vec bottom, const Vec left, const Vec right) const {
+        const typename Ops::Storage* p = porosity_row + x;
+        const auto own = Ops::load(p);
+        return Ops::add(Ops::add(Ops::add(Ops::mul(Ops::min(own, Ops::load(p + stride)), top),
+                                          Ops::mul(Ops::min(own, Ops::load(p - stride)), bottom)),
+                                 Ops::mul(Ops::min(own, Ops::load(p - 1)), left)),
+                        Ops::mul(Ops::min(own, Ops::load(p + 1)), right));
+    }
+};
+
+template <typename Ops, typename Coefficients, typename Faces>
+inline void velocity_cells(const typename Ops::Storage* h, typename Ops::Storage* v, const uint64_t* wet,
+                           const size_t bit, const int x, const int stride, const Coefficients& k,
+                           const Faces& faces, const typename Ops::Vec dt, const typename Ops::Vec snap) {
+    // One load covers the left neighbour, the cells themselves and the right neighbour
+    const uint64_t row = load_bits(wet, bit - 1);
+    const uint64_t above = load_bits(wet, bit + stride);
+    const uint64_t below = load_bits(wet, bit - stride);
+
+    const auto height0 = Ops::load(h + x);
+    const auto top = Ops::mask(Ops::sub(Ops::load(h + x + stride), height0), above);
+    const auto bottom = Ops::mask(Ops::sub(Ops::load(h + x - stride), height0), below);
+    const auto left = Ops::mask(Ops::sub(Ops::load(h + x - 1), height0), row);
+    const auto right = Ops::mask(Ops::sub(Ops::load(h + x + 1), height0), row >> 2);
+    const auto acc = Ops::mul(k.speed_squared(x), faces.sum(x, top, bottom, left, right));
+    const auto updated = Ops::add(Ops::mul(k.damping(x), Ops::load(v + x)), Ops::mul(dt, acc));
+    Ops::store(v + x, Ops::mask(Ops::snap(updated, snap), row >> 1));
+}
+
+template <typename Ops, bool Uniform, bool Porous>
+void velocity_rows(const BasicFluidGrid<typename Ops::Storage>& grid, const KernelRegion& region,
+                   const BasicMediumFields<typename Ops::Storage>* medium, const typename Ops::Compute damp,
+                   const typename Ops::Compute dt, const typename Ops::Compute c_squared_over_s_squared,
+                   const typename Ops::Compute snap) {
+    using Scalar = ScalarOps<typename Ops::Storage>;
+    const auto vdamp = Ops::set1(damp);
+    const auto vdt = Ops::set1(dt);
+    const auto vc2 = Ops::set1(c_squared_over_s_squared);
+    const auto vsnap = Ops::set1(snap);
+
+    for (int y = region.y_begin; y < region.y_end; y++) {
+        const auto* h = grid.H + y * grid.stride;
+        auto* v = grid.V + y * grid.stride;
+        const size_t row_bit = static_cast<size_t>(y + 1) * grid.stride + 1;
+        const int64_t field_row = Uniform ? 0 : static_cast<int64_t>(y + grid.y_offset) * medium->width + grid.x_offset;
+        const int64_t porosity_row = Porous ? static_cast<int64_t>(y + grid.y_offset + 1) * medium->stride +
+                                              grid.x_offset + 1 : 0;
+        const auto k = CellCoefficients<Ops, Uniform>::row(vdamp, vc2, medium, field_row);
+        const auto scalar_k = CellCoefficients<Scalar, Uniform>::row(damp, c_squared_over_s_squared, medium, field_row);
+        const auto faces = CellFaces<Ops, Porous>::row(medium, porosity_row);
+        const auto scalar_faces = CellFaces<Scalar, Porous>::row(medium, porosity_row);
+
+        int x = region.x_begin;
+        for (; x + Ops::width <= region.x_end; x += Ops::width) {
+            velocity_cells<Ops>(h, v, grid.Wet, row_bit + x, x, grid.stride, k, faces, vdt, vsnap);
+        }
+        for (; x < region.x_end; x++) {
+            velocity_cells<Scalar>(h, v, grid.Wet, row_bit + x, x, grid.stride, scalar_k, scalar_faces, dt, snap);
+        }
+    }
+}
+
+template <typename Ops>
+void update_velocities(const BasicFluidGrid<typename Ops::Storage>& grid, const KernelRegion& region,
+                       const typename Ops::Compute damp, const typename Ops::Compute dt,
+                       const typename Ops::Compute c_squared_over_s_squared, const typename Ops::Compute snap) {
+    velocity_rows<Ops, true, false>(grid, region, nullptr, damp, dt, c_squared_over_s_squared, snap);
+}
+
+template <typename Ops>
+void update_velocities_medium(const BasicFluidGrid<typename Ops::Storage>& grid, const KernelRegion& region,
+                              const BasicMediumFields<typename Ops::Storage>& medium, const typename Ops::Compute damp,
+                              const typename Ops::Compute dt, const typename Ops::Compute c_squared_over_s_squared,
+                              const typename Ops::Compute snap) {
+    if (medium.porosity == nullptr) {
+        velocity_rows<Ops, false, false>(grid, region, &medium, damp, dt, c_squared_over_s_squared, snap);
+    } else if (medium.damping == nullptr) {
+        velocity_rows<Ops, true, true>(grid, region, &medium, damp, dt, c_squared_over_s_squared, snap);
+    } else {
+        velocity_rows<Ops, false, true>(grid, region, &medium, damp, dt, c_squared_over_s_squared, snap);
+    }
+}
+
+// Vectors shared by every cell of a layer row
+template <typename Ops>
+struct PmlRow {
+    typename Ops::Vec sigma_y;
+    typename Ops::Vec sigma_y_face;
+    typename Ops::Vec half_dt_sigma_y_face;
+    typename Ops::Vec one;
+    typename Ops::Vec half_dt;
+    typename Ops::Vec dt_dt_c2;
+};
+
+template <typename Ops>
+inline void pml_cells(const typename Ops::Storage* h, typename Ops::Storage* v, const uint64_t* wet,
+                      const size_t bit, const int x, const int stride, const BasicPmlFields<typename Ops::Storage>& pml,
+                      const int64_t cell, const int64_t above, const PmlRow<Ops>& r,
+                      const typename Ops::Vec damp, const typename Ops::Vec dt, const typename Ops::Vec c2,
+                      const typename Ops::Vec snap) {
+    const uint64_t row = load_bits(wet, bit - 1);
+    const uint64_t below_row = load_bits(wet, bit + stride);
+    const uint64_t above_row = load_bits(wet, bit - stride);
+
+    const auto height0 = Ops::load(h + x);
+    const auto down = Ops::mask(Ops::sub(Ops::load(h + x + stride), height0), below_row);
+    const auto up = Ops::mask(Ops::sub(Ops::load(h + x - stride), height0), above_row);
+    const auto left = Ops::mask(Ops::sub(Ops::load(h + x - 1), height0), row);
+    const auto right = Ops::mask(Ops::sub(Ops::load(h + x + 1), height0), row >> 2);
+
+    const auto psi_x = Ops::load(pml.psi_x + cell);
+    const auto psi_y = Ops::load(pml.psi_y + cell);
+    const auto divergence = Ops::add(Ops::sub(psi_x, Ops::load(pml.psi_x + cell - 1)),
+                                     Ops::sub(psi_y, Ops::load(pml.psi_y + above)));
+    const auto sigma_x = Ops::load(pml.sigma_x + x);
+    const auto half_dt_sigma_x_face = Ops::mul(r.half_dt, Ops::load(pml.sigma_x_face + x));
+
+    // u_tt + (sx + sy) u_t + sx sy u = c^2 lap u + div psi, with the damping term centred in time
+    const auto a = Ops::mul(r.half_dt, Ops::add(sigma_x, r.sigma_y));
+    const auto acc = Ops::mul(c2, Ops::add(Ops::add(Ops::add(down, up), left), right));
+    const auto kept = Ops::mul(Ops::mul(damp, Ops::sub(r.one, a)), Ops::load(v + x));
+    const auto forced = Ops::sub(Ops::add(Ops::add(kept, Ops::mul(dt, acc)), divergence),
+                                 Ops::mul(dt, Ops::mul(Ops::mul(sigma_x, r.sigma_y), height0)));
+    const auto updated = Ops::div(forced, Ops::add(r.one, a));
+    Ops::store(v + x, Ops::mask(Ops::snap(updated, snap), row >> 1));
+
+    // psi_t = -diag(sx, sy) psi + c^2 diag(sy - sx, sx - sy) grad u, on the faces right of and below the cell
+    const auto next_x = Ops::div(
+        Ops::add(Ops::mul(psi_x, Ops::sub(r.one, half_dt_sigma_x_face)),
+                 Ops::mul(r.dt_dt_c2, Ops::mul(Ops::sub(r.sigma_y, Ops::load(pml.sigma_x_face + x)), right))),
+        Ops::add(r.one, half_dt_sigma_x_face));
+    const auto next_y = Ops::div(
+        Ops::add(Ops::mul(psi_y, Ops::sub(r.one, r.half_dt_sigma_y_face)),
+                 Ops::mul(r.dt_dt_c2, Ops::mul(Ops::sub(sigma_x, r.sigma_y_face), down))),
+        Ops::add(r.one, r.half_dt_sigma_y_face));
+    Ops::store(pml.next_psi_x + cell, Ops::mask(next_x, row >> 1));
+    Ops::store(pml.next_psi_y + cell, Ops::mask(next_y, row >> 1));
+}
+
+template <typename Ops>
+void update_velocities_pml(const BasicFluidGrid<typename Ops::Storage>& grid, const KernelRegion& region,
+                           const BasicPmlFields<typename Ops::Storage>& pml, const typename Ops::Compute damp,
+                           const typename Ops::Compute dt, const typename Ops::Compute c_squared_over_s_squared,
+                           const typename Ops::Compute snap) {
+    using Scalar = ScalarOps<typename Ops::Storage>;
+    using Compute = typename Ops::Compute;
+    const auto vdamp = Ops::set1(damp);
+    const auto vdt = Ops::set1(dt);
+    const auto vc2 = Ops::set1(c_squared_over_s_squared);
+    const auto vsnap = Ops::set1(snap);
+
+    for (int y = region.y_begin; y < region.y_end; y++) {
+        const auto* h = grid.H + y * grid.stride;
+        auto* v = grid.V + y * grid.stride;
+        const size_t row_bit = static_cast<size_t>(y + 1) * grid.stride + 1;
+
+        const Compute half_dt = dt / 2;
+        const Compute half_dt_sigma_y_face = half_dt * pml.sigma_y_face[y];
+        const Compute dt_dt_c2 = dt * dt * c_squared_over_s_squared;
+        const PmlRow<Scalar> scalar_row = {pml.sigma_y[y], pml.sigma_y_face[y], half_dt_sigma_y_face, Compute(1),
+                                           half_dt, dt_dt_c2};
+        const PmlRow<Ops> row = {Ops::set1(pml.sigma_y[y]), Ops::set1(pml.sigma_y_face[y]),
+                                 Ops::set1(half_dt_sigma_y_face), Ops::set1(Compute(1)), Ops::set1(half_dt),
+                                 Ops::set1(dt_dt_c2)};
+
+        // Offsets between a cell and its field entries are constant along a row segment
+        const int64_t cell = pml.index(region.x_begin, y) - region.x_begin;
+        const int64_t above = pml.index(region.x_begin, y - 1) - region.x_begin;
+
+        int x = region.x_begin;
+        for (; x + Ops::width <= region.x_end; x += Ops::width) {
+            pml_cells<Ops>(h, v, grid.Wet, row_bit + x, x, grid.stride, pml, cell + x, above + x, row,
+                           vdamp, vdt, vc2, vsnap);
+        }
+        for (; x < region.x_end; x++) {
+            pml_cells<Scalar>(h, v, grid.Wet, row_bit + x, x, grid.stride, pml, cell + x, above + x, scalar_row,
+                              damp, dt, c_squared_over_s_squared, snap);
+        }
+    }
+}
+
+template <typename Ops>
+inline void height_cells(typename Ops::Storage* h, const typename Ops::Storage* v, const int x,
+                         const typename Ops::Vec dt) {
+    Ops::store(h + x, Ops::add(Ops::load(h + x), Ops::mul(dt, Ops::load(v + x))));
+}
+
+template <typename Ops>
+void update_heights(const BasicFluidGrid<typename Ops::Storage>& grid, const KernelRegion& region,
+                    const typename Ops::Compute dt) {
+    using Scalar = ScalarOps<typename Ops::Storage>;
+    const auto vdt = Ops::set1(dt);
+
+    for (int y = region.y_begin; y < region.y_end; y++) {
+        const auto* v = grid.V + y * grid.stride;
+        auto* h = grid.H + y * grid.stride;
+
+        int x = region.x_begin;
+        for (; x + Ops::width <= region.x_end; x += Ops::width) {
+            height_cells<Ops>(h, v, x, vdt);
+        }
+        for (; x < region.x_end; x++) {
+            height_cells<Scalar>(h, v, x, dt);
+        }
+    }
+}
+
+template <typename Ops>
+inline void color_cells(const typename Ops::Storage* h, const uint64_t* wet, const size_t bit, const int x,
+                        uint32_t* out, const uint32_t* colors, const int32_t dry,
+                        const typename Ops::Vec offset, const typename Ops::Vec scale,
+                        const typename Ops::Vec zero, const typename Ops::Vec top) {
+    // max first so NaN heights land on entry 0
+    const auto index = Ops::min(Ops::max(Ops::mul(Ops::sub(Ops::load(h + x), offset), scale), zero), top);
+    Ops::lookup(out, colors, index, load_bits(wet, bit), dry);
+}
+
+template <typename Ops>
+void map_colors(const BasicFluidGrid<typename Ops::Storage>& grid, const KernelRegion& region, const ColorLut& lut,
+                uint32_t* pixels, const int pitch) {
+    using Scalar = ScalarOps<typename Ops::Storage>;
+    using Compute = typename Ops::Compute;
+    const Compute offset = lut.offset;
+    const Compute scale = lut.scale;
+    const Compute top = static_cast<Compute>(lut.levels - 1);
+    const auto voffset = Ops::set1(offset);
+    const auto vscale = Ops::set1(scale);
+    const auto vzero = Ops::set1(Compute(0));
+    const auto vtop = Ops::set1(top);
+
+    for (int y = region.y_begin; y < region.y_end; y++) {
+        const auto* h = grid.H + y * grid.stride;
+        uint32_t* out = pixels + (y - region.y_begin) * pitch - region.x_begin;
+        const size_t row_bit = static_cast<size_t>(y + 1) * grid.stride + 1;
+
+        int x = region.x_begin;
+        for (; x + Ops::width <= region.x_end; x += Ops::width) {
+            color_cells<Ops>(h, grid.Wet, row_bit + x, x, out + x, lut.colors, lut.levels,
+                             voffset, vscale, vzero, vtop);
+        }
+        for (; x < region.x_end; x++) {
+            color_cells<Scalar>(h, grid.Wet, row_bit + x, x, out + x, lut.colors, lut.levels,
+                                offset, scale, Compute(0), top);
+        }
+    }
+}
+
+template <typename Ops>
+constexpr BasicKernelSet<typename Ops::Storage> make_kernel_set(const char* name) {
+    return BasicKernelSet<typename Ops::Storage>{name, &update_velocities<Ops>, &update_velocities_medium<Ops>,
+                                                 &update_velocities_pml<Ops>, &update_heights<Ops>, &map_colors<Ops>};
+}
+
+#endif // KERNELS_IMPL_H
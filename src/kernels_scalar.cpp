@@ -0,0 +1,16 @@
+#include "kernels_impl.h"
+
+const KernelSet& kernels::scalar() {
+    static constexpr KernelSet set = make_kernel_set<ScalarOps<float>>("scalar");
+    return set;
+}
+
+const BasicKernelSet<double>& kernels::scalar_double() {
+    static constexpr BasicKernelSet<double> set = make_kernel_set<ScalarOps<double>>("scalar");
+    return set;
+}
+
+const BasicKernelSet<Half>& kernels::scalar_half() {
+    static constexpr BasicKernelSet<Half> set = make_kernel_set<ScalarOps<Half>>("scalar");
+    return set;
+}
@@ -0,0 +1,48 @@
+#include "kernels_impl.h"
+
+#if defined(__x86_64__) || defined(_M_X64)
+#include <immintrin.h>
+
+struct SseOps {
+    using Storage = float;
+    using Compute = float;
+    using Vec = __m128;
+    static constexpr int width = 4;
+
+    static Vec load(const float* p) { return _mm_loadu_ps(p); }
+    static void store(float* p, Vec v) { _mm_storeu_ps(p, v); }
+    static Vec set1(float v) { return _mm_set1_ps(v); }
+    static Vec add(Vec a, Vec b) { return _mm_add_ps(a, b); }
+    static Vec sub(Vec a, Vec b) { return _mm_sub_ps(a, b); }
+    static Vec mul(Vec a, Vec b) { return _mm_mul_ps(a, b); }
+    static Vec div(Vec a, Vec b) { return _mm_div_ps(a, b); }
+    static Vec mask(Vec v, uint64_t bits) {
+        const __m128i lane_bits = _mm_setr_epi32(1, 2, 4, 8);
+        const __m128i set = _mm_and_si128(_mm_set1_epi32(static_cast<int>(bits)), lane_bits);
+        return _mm_and_ps(v, _mm_castsi128_ps(_mm_cmpeq_epi32(set, lane_bits)));
+    }
+    static Vec min(Vec a, Vec b) { return _mm_min_ps(a, b); }
+    static Vec max(Vec a, Vec b) { return _mm_max_ps(a, b); }
+    static Vec snap(Vec v, Vec epsilon) {
+        const __m128 small = _mm_cmplt_ps(_mm_andnot_ps(_mm_set1_ps(-0.0f), v), epsilon);
+        return _mm_andnot_ps(small, v);
+    }
+    static void lookup(uint32_t* out, const uint32_t* colors, Vec index, uint64_t bits, int32_t dry) {
+        // No gather before AVX2, so look the lanes up one by one
+        alignas(16) int32_t lanes[width];
+        _mm_store_si128(reinterpret_cast<__m128i*>(lanes), _mm_cvttps_epi32(index));
+        for (int i = 0; i < width; i++) {
+            out[i] = colors[((bits >> i) & 1u) ? lanes[i] : dry];
+        }
+    }
+};
+
+const KernelSet* kernels::sse() {
+    static constexpr KernelSet set = make_kernel_set<SseOps>("sse");
+    return &set;
+}
+#else
+const KernelSet* kernels::sse() {
+    return nullptr;
+}
+#endif
@@ -1,5 +1,18 @@
 #include "../include/renderer.h"
 #include "../include/fluid.h"
+#include "../include/fluid_view.h"
+#include "../include/profiler.h"
+#include "../include/simulation_thread.h"
+#include "../include/wave_plot.h"
+
+#include <atomic>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <string>
+#include <thread>
 
 #define SCREEN_WIDTH 1000
 #define SCREEN_HEIGHT 600
@@ -8,8 +21,19 @@ int circ_x = SCREEN_WIDTH / 2;
 int circ_y = SCREEN_HEIGHT / 2;
 
 
-void handle_input(Renderer* renderer, Fluid& fluid)
+// Write the zones recorded so far to a trace file and print the per-zone totals
+void dump_profile()
+{
+    const char* path = "wavesim_trace.json";
+    std::ofstream trace(path);
+    profiler::write_chrome_trace(trace);
+    std::cout << "wrote " << path << std::endl;
+    profiler::print_zone_stats(std::cout);
+}
+
+void handle_input(Renderer* renderer, SimulationThread& simulation, FluidView& view)
 {
+    WAVESIM_ZONE("input");
     SDL_Event event;
     while (SDL_PollEvent(&event))
     {
@@ -24,6 +48,9 @@ void handle_input(Renderer* renderer, Fluid& fluid)
             case SDLK_DOWN: break;
             case SDLK_LEFT: break;
             case SDLK_RIGHT: break;
+            case SDLK_r: simulation.set_realtime(!simulation.realtime()); break;
+            case SDLK_p: view.cycle_palette(); break;
+            case SDLK_t: dump_profile(); break;
             default: break;
             }
         }
@@ -31,25 +58,102 @@ void handle_input(Renderer* renderer, Fluid& fluid)
         {
             int xMouse = 0, yMouse = 0;
             SDL_GetMouseState(&xMouse,&yMouse);
-            fluid.add_velocity(xMouse, yMouse);
+            simulation.add_velocity(xMouse, yMouse);
         }
     }
 }
 
-int main()
+int main(int argc, char* argv[])
 {
+    // --plot also shows the height field in a matplotlib window, --gauges plots the
+    // water level over time at a few points instead. --inline steps the simulation
+    // between frames on the display thread, --vsync paces frames by the display refresh.
+    bool plot = false;
+    bool gauges = false;
+    bool inline_steps = false;
+    bool vsync = false;
+    for (int i = 1; i < argc; i++) {
+        plot = plot || std::strcmp(argv[i], "--plot") == 0;
+        gauges = gauges || std::strcmp(argv[i], "--gauges") == 0;
+        inline_steps = inline_steps || std::strcmp(argv[i], "--inline") == 0;
+        vsync = vsync || std::strcmp(argv[i], "--vsync") == 0;
+    }
+    // Both plotters drive the one embedded matplotlib interpreter and its current figure
+    if (plot && gauges) {
+        std::fprintf(stderr, "usage: %s [--plot | --gauges] [--inline] [--vsync]\n"
+                             "--plot and --gauges cannot be combined\n", argv[0]);
+        return 1;
+    }
+
+    profiler::set_thread_name("main");
+
     auto renderer = Renderer("Fluid Sim", SCREEN_HEIGHT, SCREEN_WIDTH, 240);
+    renderer.setVSync(vsync);
     renderer.initialize();
 
     constexpr int downsample = 4;
     auto fluid = Fluid(SCREEN_HEIGHT/downsample , SCREEN_WIDTH/downsample, 1.0f / 48000.0f,2.0f, 0.001f, SCREEN_HEIGHT, SCREEN_WIDTH);
+    fluid.set_threads(0);
+    FluidView view;
+
+    // The plotter gets a frame every 10 ms of simulated time, averaged over 2x2 cells
+    SnapshotChannel plot_channel(fluid.width(), fluid.height(), 2, 4, 480);
+    std::atomic<bool> plotting(plot || gauges);
+    std::thread plot_thread;
+    if (plot) {
+        fluid.add_snapshot_channel(plot_channel);
+        plot_thread = std::thread(plot_waves, std::ref(plot_channel), std::cref(plotting));
+    }
+
+    // Gauges at a quarter, half and three quarters of the way along the middle row
+    ProbeRecorder gauge_recorder(3, false, 48000);
+    if (gauges) {
+        for (int i = 1; i <= 3; i++) {
+            fluid.add_probe(fluid.width() * i / 4, fluid.height() / 2);
+        }
+        fluid.record_probes(&gauge_recorder);
+        plot_thread = std::thread(plot_gauges, std::ref(gauge_recorder), fluid.dt(), std::cref(plotting));
+    }
+
+    // The simulation steps on its own thread and this thread only handles input and
+    // draws, unless --inline asks for the spare time of each frame to be spent on steps
+    constexpr float halflife = 0.7f;
+    SimulationThread simulation(fluid, halflife);
+    if (!inline_steps) {
+        simulation.start();
+    }
 
+    FrameScheduler& scheduler = renderer.scheduler();
+    std::string title;
+    double reported_fps = 0.0;
     while(renderer.isLive())
     {
-        handle_input(&renderer,fluid);
-        fluid.step(0.7f);
-        fluid.render(&renderer);
+        handle_input(&renderer,simulation,view);
+
+        if (inline_steps) {
+            scheduler.fill([&] { return simulation.pump(); });
+        }
+        if (const FluidSnapshot<>* snapshot = simulation.latest()) {
+            view.render(*snapshot, &renderer);
+            scheduler.record_sim_time(snapshot->sim_time());
+        }
         renderer.draw();
+
+        // Show the achieved rates whenever a new measurement is in
+        if (scheduler.fps() != reported_fps) {
+            reported_fps = scheduler.fps();
+            char buffer[96];
+            std::snprintf(buffer, sizeof(buffer), "Fluid Sim - %.0f fps, %.3f sim s/s, %.0f%% busy",
+                          scheduler.fps(), scheduler.sim_rate(), 100.0 * scheduler.busy());
+            title = buffer;
+            renderer.setTitle(title.c_str());
+        }
+    }
+
+    simulation.stop();
+    plotting.store(false);
+    if (plot_thread.joinable()) {
+        plot_thread.join();
     }
     return 0;
 }
@@ -0,0 +1,131 @@
+#include "../include/perf_counters.h"
+
+#include <cerrno>
+#include <cstring>
+
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+namespace {
+    constexpr int event_count = static_cast<int>(PerfEvent::Count);
+
+#ifdef __linux__
+    int openEvent(const PerfEvent event, const int group) {
+        perf_event_attr attr;
+        std::memset(&attr, 0, sizeof(attr));
+        attr.size = sizeof(attr);
+        attr.type = PERF_TYPE_HARDWARE;
+        switch (event) {
+            case PerfEvent::Cycles: attr.config = PERF_COUNT_HW_CPU_CYCLES; break;
+            case PerfEvent::Instructions: attr.config = PERF_COUNT_HW_INSTRUCTIONS; break;
+            case PerfEvent::LlcMisses: attr.config = PERF_COUNT_HW_CACHE_MISSES; break;
+            case PerfEvent::BranchMisses: attr.config = PERF_COUNT_HW_BRANCH_MISSES; break;
+            case PerfEvent::L1dReadMisses:
+                attr.type = PERF_TYPE_HW_CACHE;
+                attr.config = PERF_COUNT_HW_CACHE_L1D | (PERF_COUNT_HW_CACHE_OP_READ << 8) |
+                              (PERF_COUNT_HW_CACHE_RESULT_MISS << 16);
+                break;
+            default: return -1;
+        }
+        attr.exclude_kernel = 1;
+        attr.exclude_hv = 1;
+        attr.read_format = PERF_FORMAT_GROUP | PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+        return static_cast<int>(syscall(SYS_perf_event_open, &attr, 0, -1, group, 0));
+    }
+#endif
+}
+
+PerfCounters::PerfCounters()
+    : m_opened(0), m_thread(std::this_thread::get_id())
+{
+    for (int i = 0; i < event_count; i++) {
+        m_fds[i] = -1;
+        m_slots[i] = -1;
+    }
+
+#ifdef __linux__
+    // Cycles lead the group; the other events are optional members
+    m_fds[0] = openEvent(PerfEvent::Cycles, -1);
+    if (m_fds[0] < 0) {
+        m_error = std::string("perf_event_open failed: ") + std::strerror(errno);
+        return;
+    }
+    m_slots[0] = m_opened++;
+    for (int i = 1; i < event_count; i++) {
+        m_fds[i] = openEvent(static_cast<PerfEvent>(i), m_fds[0]);
+        if (m_fds[i] >= 0) {
+            m_slots[i] = m_opened++;
+        }
+    }
+#else
+    m_error = "hardware counters are only read on Linux";
+#endif
+}
+
+PerfCounters::~PerfCounters() {
+#ifdef __linux__
+    for (const int fd : m_fds) {
+        if (fd >= 0) {
+            close(fd);
+        }
+    }
+#endif
+}
+
+bool PerfCounters::available() const {
+    return m_fds[0] >= 0;
+}
+
+bool PerfCounters::has(const PerfEvent event) const {
+    return m_fds[static_cast<int>(event)] >= 0;
+}
+
+const std::string& PerfCounters::error() const {
+    return m_error;
+}
+
+std::thread::id PerfCounters::thread() const {
+    return m_thread;
+}
+
+PerfSample PerfCounters::read() const {
+    PerfSample sample;
+#ifdef __linux__
+    if (!available()) {
+        return sample;
+    }
+
+    // Group layout: event count, time enabled, time running, then one value per event
+    uint64_t buffer[3 + event_count];
+    if (::read(m_fds[0], buffer, sizeof(buffer)) < static_cast<ssize_t>((3 + m_opened) * sizeof(uint64_t))) {
+        return sample;
+    }
+    const uint64_t enabled = buffer[1];
+    const uint64_t running = buffer[2];
+    for (int i = 0; i < event_count; i++) {
+        if (m_slots[i] < 0) {
+            continue;
+        }
+        const uint64_t value = buffer[3 + m_slots[i]];
+        sample.values[i] = running > 0 && running < enabled
+                               ? static_cast<uint64_t>(static_cast<double>(value) * enabled / running)
+                               : value;
+    }
+#endif
+    return sample;
+}
+
+const char* PerfCounters::name(const PerfEvent event) {
+    switch (event) {
+        case PerfEvent::Cycles: return "cycles";
+        case PerfEvent::Instructions: return "instructions";
+        case PerfEvent::L1dReadMisses: return "l1d_read_misses";
+        case PerfEvent::LlcMisses: return "llc_misses";
+        case PerfEvent::BranchMisses: return "branch_misses";
+        default: return "unknown";
+    }
+}
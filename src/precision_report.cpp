@@ -0,0 +1,109 @@
+// Runs the same scenario in every precision mode and reports how far the float
+// and half-storage heights drift from a double-precision reference run.
+
+#include "../include/fluid.h"
+
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+
+#define SCREEN_WIDTH 1000
+#define SCREEN_HEIGHT 600
+
+constexpr int downsample = 4;
+constexpr float halflife = 0.7f;
+
+template <typename Storage>
+void splash(Fluid<Storage>& fluid) {
+    fluid.add_velocity(SCREEN_WIDTH / 10, SCREEN_HEIGHT / 2);
+    fluid.add_velocity(SCREEN_WIDTH - SCREEN_WIDTH / 10, SCREEN_HEIGHT / 3);
+}
+
+struct ErrorStats {
+    double max_abs;
+    double rms;
+};
+
+template <typename Storage>
+ErrorStats compare(const Fluid<double>& reference, const Fluid<Storage>& fluid) {
+    constexpr int height = SCREEN_HEIGHT / downsample;
+    constexpr int width = SCREEN_WIDTH / downsample;
+
+    ErrorStats stats = {0.0, 0.0};
+    for (int y = 0; y < height; y++) {
+        for (int x = 0; x < width; x++) {
+            const double error = fluid.height_at(x, y) - reference.height_at(x, y);
+            stats.max_abs = std::max(stats.max_abs, std::abs(error));
+            stats.rms += error * error;
+        }
+    }
+    stats.rms = std::sqrt(stats.rms / (height * width));
+    return stats;
+}
+
+double rms_height(const Fluid<double>& reference) {
+    constexpr int height = SCREEN_HEIGHT / downsample;
+    constexpr int width = SCREEN_WIDTH / downsample;
+
+    double sum = 0.0;
+    for (int y = 0; y < height; y++) {
+        for (int x = 0; x < width; x++) {
+            sum += reference.height_at(x, y) * reference.height_at(x, y);
+        }
+    }
+    return std::sqrt(sum / (height * width));
+}
+
+static void usage(const char* program) {
+    std::fprintf(stderr, "usage: %s [STEPS [REPORT_EVERY]]\n"
+                         "both must be positive integers\n", program);
+    exit(1);
+}
+
+// Positive integer argument, or usage
+static int parseCount(const char* program, const char* text) {
+    char* end = nullptr;
+    const long value = std::strtol(text, &end, 10);
+    if (end == text || *end != '\0' || value <= 0 || value > 1000000000L) {
+        usage(program);
+    }
+    return static_cast<int>(value);
+}
+
+int main(int argc, char* argv[])
+{
+    if (argc > 3) {
+        usage(argv[0]);
+    }
+    const int steps = argc > 1 ? parseCount(argv[0], argv[1]) : 48000;
+    const int report_every = argc > 2 ? parseCount(argv[0], argv[2]) : 4800;
+
+    Fluid<double> reference(SCREEN_HEIGHT / downsample, SCREEN_WIDTH / downsample, 1.0f / 48000.0f, 2.0f, 0.001f,
+                            SCREEN_HEIGHT, SCREEN_WIDTH);
+    Fluid<float> single(SCREEN_HEIGHT / downsample, SCREEN_WIDTH / downsample, 1.0f / 48000.0f, 2.0f, 0.001f,
+                        SCREEN_HEIGHT, SCREEN_WIDTH);
+    Fluid<Half> half(SCREEN_HEIGHT / downsample, SCREEN_WIDTH / downsample, 1.0f / 48000.0f, 2.0f, 0.001f,
+                     SCREEN_HEIGHT, SCREEN_WIDTH);
+    splash(reference);
+    splash(single);
+    splash(half);
+
+    std::printf("%10s %12s %14s %14s %14s %14s %14s\n", "step", "rms height",
+                "float max", "float rms", "half max", "half rms", "half rel rms");
+
+    for (int done = 0; done < steps;) {
+        const int batch = std::min(report_every, steps - done);
+        reference.advance(batch, halflife);
+        single.advance(batch, halflife);
+        half.advance(batch, halflife);
+        done += batch;
+
+        const double scale = rms_height(reference);
+        const ErrorStats single_error = compare(reference, single);
+        const ErrorStats half_error = compare(reference, half);
+        std::printf("%10d %12.4e %14.4e %14.4e %14.4e %14.4e %14.4e\n", done, scale,
+                    single_error.max_abs, single_error.rms, half_error.max_abs, half_error.rms,
+                    scale > 0.0 ? half_error.rms / scale : 0.0);
+    }
+    return 0;
+}
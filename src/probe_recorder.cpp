@@ -0,0 +1,60 @@
+#include "../include/probe_recorder.h"
+
+#include <iostream>
+
+ProbeRecorder::ProbeRecorder(const int probes, const bool record_velocity, const size_t capacity)
+    : m_probes(probes), m_record_velocity(record_velocity), m_capacity(capacity),
+      m_record_size(static_cast<size_t>(probes) * (record_velocity ? 2 : 1)),
+      m_written(0), m_released(0), m_dropped(0)
+{
+    if (probes <= 0 || capacity == 0) {
+        std::cerr << "Probe recorder needs at least one probe and one record" << std::endl;
+        exit(1);
+    }
+    m_values.assign(m_capacity * m_record_size, 0.0f);
+    m_steps.assign(m_capacity, 0);
+}
+
+int ProbeRecorder::probes() const {
+    return m_probes;
+}
+
+bool ProbeRecorder::records_velocity() const {
+    return m_record_velocity;
+}
+
+size_t ProbeRecorder::capacity() const {
+    return m_capacity;
+}
+
+size_t ProbeRecorder::reserve(const size_t count) {
+    const uint64_t written = m_written.load(std::memory_order_relaxed);
+    const uint64_t released = m_released.load(std::memory_order_acquire);
+    const size_t free = m_capacity - static_cast<size_t>(written - released);
+    if (count <= free) {
+        return count;
+    }
+    m_dropped.fetch_add(count - free, std::memory_order_relaxed);
+    return free;
+}
+
+float* ProbeRecorder::heights(const size_t offset) {
+    const size_t slot = (m_written.load(std::memory_order_relaxed) + offset) % m_capacity;
+    return &m_values[slot * m_record_size];
+}
+
+float* ProbeRecorder::velocities(const size_t offset) {
+    return m_record_velocity ? heights(offset) + m_probes : nullptr;
+}
+
+void ProbeRecorder::commit(const size_t count, const uint64_t first_step) {
+    const uint64_t written = m_written.load(std::memory_order_relaxed);
+    for (size_t i = 0; i < count; i++) {
+        m_steps[(written + i) % m_capacity] = first_step + i;
+    }
+    m_written.store(written + count, std::memory_order_release);
+}
+
+uint64_t ProbeRecorder::dropped() const {
+    return m_dropped.load(std::memory_order_relaxed);
+}
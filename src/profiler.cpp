@@ -0,0 +1,275 @@
+#include "../include/profiler.h"
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstring>
+#include <iomanip>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+namespace profiler {
+
+#ifdef WAVESIM_PROFILE
+namespace {
+    // Distinct WAVESIM_ZONE call sites; later sites are not recorded
+    constexpr int max_sites = 256;
+
+    // Zones kept per thread for the trace, about 1.5 MB per thread
+    constexpr uint64_t ring_capacity = uint64_t(1) << 16;
+
+    // Timestamp counter ticks are converted to time over at least this much wall-clock time
+    constexpr std::chrono::milliseconds calibration_time(20);
+
+    // Ring entries and counters are written by their own thread only and read by the
+    // exporting thread, so relaxed atomics are enough; on x86 they are plain moves
+    struct Event {
+        std::atomic<int> site;
+        std::atomic<uint64_t> start;
+        std::atomic<uint64_t> end;
+    };
+
+    struct Counters {
+        std::atomic<uint64_t> calls{0};
+        std::atomic<uint64_t> ticks{0};
+        std::atomic<uint64_t> max_ticks{0};
+    };
+
+    struct ThreadLog {
+        int tid;
+        std::atomic<const char*> name{nullptr};
+        std::unique_ptr<Event[]> events{new Event[ring_capacity]};
+        std::atomic<uint64_t> claimed{0};    // Events whose slot is being or has been written
+        std::atomic<uint64_t> committed{0};  // Events fully written
+        Counters counters[max_sites];
+    };
+
+    // Logs outlive their threads so that zones of finished threads can still be exported
+    struct Registry {
+        std::mutex mutex;
+        const char* sites[max_sites] = {};
+        std::atomic<int> site_count{0};
+        std::vector<std::unique_ptr<ThreadLog>> threads;
+        uint64_t start_ticks = Zone::ticks();
+        std::chrono::steady_clock::time_point start_time = std::chrono::steady_clock::now();
+    };
+
+    Registry& registry() {
+        static Registry instance;
+        return instance;
+    }
+
+    ThreadLog& threadLog() {
+        thread_local ThreadLog* log = nullptr;
+        if (log == nullptr) {
+            Registry& reg = registry();
+            std::lock_guard<std::mutex> lock(reg.mutex);
+            reg.threads.push_back(std::make_unique<ThreadLog>());
+            log = reg.threads.back().get();
+            log->tid = static_cast<int>(reg.threads.size());
+        }
+        return *log;
+    }
+
+    void bump(std::atomic<uint64_t>& counter, const uint64_t amount) {
+        counter.store(counter.load(std::memory_order_relaxed) + amount, std::memory_order_relaxed);
+    }
+
+    // Microseconds per tick, measured against the system clock since the first zone
+    double microsecondsPerTick() {
+        Registry& reg = registry();
+        const auto elapsed = std::chrono::steady_clock::now() - reg.start_time;
+        if (elapsed < calibration_time) {
+            std::this_thread::sleep_for(calibration_time - elapsed);
+        }
+        const uint64_t ticks = Zone::ticks();
+        const double micros = std::chrono::duration<double, std::micro>(std::chrono::steady_clock::now() - reg.start_time).count();
+        return micros / static_cast<double>(ticks - reg.start_ticks);
+    }
+
+    // Escape a name for a JSON string
+    void writeString(std::ostream& out, const char* text) {
+        out << '"';
+        for (const char* c = text; *c != '\0'; c++) {
+            if (*c == '"' || *c == '\\') {
+                out << '\\';
+            }
+            out << *c;
+        }
+        out << '"';
+    }
+}
+
+Site::Site(const char* name)
+    : m_id(-1)
+{
+    Registry& reg = registry();
+    std::lock_guard<std::mutex> lock(reg.mutex);
+    const int count = reg.site_count.load(std::memory_order_relaxed);
+    if (count < max_sites) {
+        reg.sites[count] = name;
+        reg.site_count.store(count + 1, std::memory_order_release);
+        m_id = count;
+    }
+}
+
+void Zone::record(const int site, const uint64_t start, const uint64_t end) {
+    if (site < 0) {
+        return;
+    }
+    ThreadLog& log = threadLog();
+
+    const uint64_t duration = end - start;
+    Counters& counters = log.counters[site];
+    bump(counters.calls, 1);
+    bump(counters.ticks, duration);
+    if (duration > counters.max_ticks.load(std::memory_order_relaxed)) {
+        counters.max_ticks.store(duration, std::memory_order_relaxed);
+    }
+
+    // Claim the slot before overwriting it, so a concurrent export can tell which
+    // entries it may have read half-written
+    const uint64_t index = log.committed.load(std::memory_order_relaxed);
+    log.claimed.store(index + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    Event& event = log.events[index % ring_capacity];
+    event.site.store(site, std::memory_order_relaxed);
+    event.start.store(start, std::memory_order_relaxed);
+    event.end.store(end, std::memory_order_relaxed);
+    log.committed.store(index + 1, std::memory_order_release);
+}
+
+void set_thread_name(const char* name) {
+    threadLog().name.store(name, std::memory_order_relaxed);
+}
+
+std::vector<ZoneStats> zone_stats() {
+    Registry& reg = registry();
+    const double us_per_tick = microsecondsPerTick();
+
+    std::lock_guard<std::mutex> lock(reg.mutex);
+    const int sites = reg.site_count.load(std::memory_order_acquire);
+
+    // Template instantiations register one site each, so sites are merged by name
+    std::vector<ZoneStats> stats;
+    for (int site = 0; site < sites; site++) {
+        auto it = std::find_if(stats.begin(), stats.end(), [&](const ZoneStats& zone) {
+            return std::strcmp(zone.name, reg.sites[site]) == 0;
+        });
+        if (it == stats.end()) {
+            stats.push_back({reg.sites[site], 0, 0.0, 0.0});
+            it = stats.end() - 1;
+        }
+        for (const auto& log : reg.threads) {
+            const Counters& counters = log->counters[site];
+            it->calls += counters.calls.load(std::memory_order_relaxed);
+            it->total_ms += counters.ticks.load(std::memory_order_relaxed) * us_per_tick * 1e-3;
+            it->max_ms = std::max(it->max_ms, counters.max_ticks.load(std::memory_order_relaxed) * us_per_tick * 1e-3);
+        }
+    }
+
+    stats.erase(std::remove_if(stats.begin(), stats.end(), [](const ZoneStats& zone) { return zone.calls == 0; }),
+                stats.end());
+    std::sort(stats.begin(), stats.end(), [](const ZoneStats& a, const ZoneStats& b) {
+        return a.total_ms > b.total_ms;
+    });
+    return stats;
+}
+
+void write_chrome_trace(std::ostream& out) {
+    Registry& reg = registry();
+    const double us_per_tick = microsecondsPerTick();
+
+    std::lock_guard<std::mutex> lock(reg.mutex);
+    const int sites = reg.site_count.load(std::memory_order_acquire);
+    std::vector<const char*> names(reg.sites, reg.sites + sites);
+
+    const auto old_flags = out.flags();
+    const auto old_precision = out.precision();
+    out << std::fixed << std::setprecision(3);
+    out << "{\"traceEvents\":[\n";
+    bool first = true;
+    const auto separator = [&] {
+        if (!first) {
+            out << ",\n";
+        }
+        first = false;
+    };
+
+    std::vector<std::pair<int, std::pair<uint64_t, uint64_t>>> events;
+    for (const auto& log : reg.threads) {
+        if (const char* name = log->name.load(std::memory_order_relaxed)) {
+            separator();
+            out << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << log->tid << ",\"args\":{\"name\":";
+            writeString(out, name);
+            out << "}}";
+        }
+
+        // Copy the ring, then drop whatever the thread may have overwritten meanwhile
+        const uint64_t committed = log->committed.load(std::memory_order_acquire);
+        const uint64_t oldest = committed > ring_capacity ? committed - ring_capacity : 0;
+        events.clear();
+        for (uint64_t i = oldest; i < committed; i++) {
+            const Event& event = log->events[i % ring_capacity];
+            events.push_back({event.site.load(std::memory_order_relaxed),
+                              {event.start.load(std::memory_order_relaxed), event.end.load(std::memory_order_relaxed)}});
+        }
+        std::atomic_thread_fence(std::memory_order_acquire);
+        const uint64_t claimed = log->claimed.load(std::memory_order_relaxed);
+        const uint64_t valid = claimed > ring_capacity ? claimed - ring_capacity : 0;
+
+        for (uint64_t i = std::max(oldest, valid); i < committed; i++) {
+            const auto& [site, span] = events[i - oldest];
+            if (site < 0 || site >= sites) {
+                continue;
+            }
+            separator();
+            out << "{\"name\":";
+            writeString(out, names[site]);
+            out << ",\"ph\":\"X\",\"pid\":1,\"tid\":" << log->tid
+                << ",\"ts\":" << (span.first - reg.start_ticks) * us_per_tick
+                << ",\"dur\":" << (span.second - span.first) * us_per_tick << "}";
+        }
+    }
+
+    out << "\n],\"displayTimeUnit\":\"ns\"}\n";
+    out.flags(old_flags);
+    out.precision(old_precision);
+}
+#else
+void set_thread_name(const char*) {
+}
+
+std::vector<ZoneStats> zone_stats() {
+    return {};
+}
+
+void write_chrome_trace(std::ostream& out) {
+    out << "{\"traceEvents\":[]}\n";
+}
+#endif
+
+void print_zone_stats(std::ostream& out) {
+    if (!enabled()) {
+        out << "profiling is disabled; build with -DWAVESIM_PROFILING=ON" << std::endl;
+        return;
+    }
+
+    const auto old_flags = out.flags();
+    const auto old_precision = out.precision();
+    out << std::left << std::setw(28) << "zone" << std::right << std::setw(12) << "calls"
+        << std::setw(14) << "total ms" << std::setw(12) << "mean us" << std::setw(12) << "max us" << '\n';
+    out << std::fixed;
+    for (const ZoneStats& zone : zone_stats()) {
+        out << std::left << std::setw(28) << zone.name << std::right << std::setw(12) << zone.calls
+            << std::setprecision(3) << std::setw(14) << zone.total_ms
+            << std::setw(12) << zone.total_ms * 1e3 / zone.calls
+            << std::setw(12) << zone.max_ms * 1e3 << '\n';
+    }
+    out.flush();
+    out.flags(old_flags);
+    out.precision(old_precision);
+}
+
+}
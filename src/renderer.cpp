@@ -1,4 +1,5 @@
 #include "../include/renderer.h"
+#include "../include/profiler.h"
 #include <iostream>
 #include <stdexcept>
 
@@ -7,8 +8,11 @@ Renderer::Renderer(const char* title, int height, int width, int fps)
       m_height(height),
       m_width(width),
       m_fps(fps),
+      m_vsync(false),
       m_window(nullptr),
       m_renderer(nullptr),
+      m_frame(nullptr),
+      m_scheduler(fps),
       m_running(false),
       m_closeRequested(false)
 {
@@ -21,6 +25,11 @@ Renderer::~Renderer()
 
 void Renderer::cleanup()
 {
+    if (m_frame) {
+        SDL_DestroyTexture(m_frame);
+        m_frame = nullptr;
+    }
+
     if (m_renderer) {
         SDL_DestroyRenderer(m_renderer);
         m_renderer = nullptr;
@@ -85,7 +94,15 @@ void Renderer::createWindow()
 
 void Renderer::createRenderer()
 {
-    m_renderer = SDL_CreateRenderer(m_window, -1, SDL_RENDERER_ACCELERATED);
+    Uint32 flags = SDL_RENDERER_ACCELERATED;
+    if (m_vsync) {
+        flags |= SDL_RENDERER_PRESENTVSYNC;
+    }
+    m_renderer = SDL_CreateRenderer(m_window, -1, flags);
+    if (!m_renderer) {
+        // No GPU renderer, e.g. on the dummy video driver; draw in software instead
+        m_renderer = SDL_CreateRenderer(m_window, -1, (flags & ~SDL_RENDERER_ACCELERATED) | SDL_RENDERER_SOFTWARE);
+    }
     if (!m_renderer) {
         throw std::runtime_error(std::string("Could not create renderer: ") + SDL_GetError());
     }
@@ -100,10 +117,15 @@ void Renderer::clear() const
     SDL_RenderClear(m_renderer);
 }
 
-void Renderer::draw() const
+void Renderer::draw()
 {
-    SDL_RenderPresent(m_renderer);
-    SDL_Delay(1000 / m_fps);
+    {
+        WAVESIM_ZONE("draw");
+        SDL_RenderPresent(m_renderer);
+    }
+
+    WAVESIM_ZONE("frame wait");
+    m_scheduler.end_frame();
 }
 
 void Renderer::drawRectangle(int x, int y, int width, int height, SDL_Color color) const
@@ -118,6 +140,44 @@ void Renderer::drawRectangle(int x, int y, int width, int height, SDL_Color colo
     SDL_RenderFillRect(m_renderer, &rect);
 }
 
+void Renderer::createFrame(int width, int height)
+{
+    if (m_frame) {
+        SDL_DestroyTexture(m_frame);
+        m_frame = nullptr;
+    }
+
+    // Scale cells up as crisp blocks; the hint is read when the texture is created
+    SDL_SetHint(SDL_HINT_RENDER_SCALE_QUALITY, "0");
+    m_frame = SDL_CreateTexture(m_renderer, SDL_PIXELFORMAT_RGBA32, SDL_TEXTUREACCESS_STREAMING, width, height);
+    SDL_SetHint(SDL_HINT_RENDER_SCALE_QUALITY, "1");
+    if (!m_frame) {
+        throw std::runtime_error(std::string("Could not create frame texture: ") + SDL_GetError());
+    }
+
+    // Blend like the per-cell rectangles did
+    SDL_SetTextureBlendMode(m_frame, SDL_BLENDMODE_BLEND);
+}
+
+unsigned char* Renderer::lockFrame(int* pitch)
+{
+    void* pixels = nullptr;
+    if (SDL_LockTexture(m_frame, nullptr, &pixels, pitch) < 0) {
+        throw std::runtime_error(std::string("Could not lock frame texture: ") + SDL_GetError());
+    }
+    return static_cast<unsigned char*>(pixels);
+}
+
+void Renderer::unlockFrame()
+{
+    SDL_UnlockTexture(m_frame);
+}
+
+void Renderer::drawFrame() const
+{
+    SDL_RenderCopy(m_renderer, m_frame, nullptr, nullptr);
+}
+
 void Renderer::handleEvents()
 {
     SDL_Event event;
@@ -146,4 +206,16 @@ void Renderer::setTitle(const char* title)
 void Renderer::setFPS(int fps)
 {
     m_fps = fps;
+    m_scheduler.set_target_fps(fps);
+}
+
+void Renderer::setVSync(bool vsync)
+{
+    m_vsync = vsync;
+    m_scheduler.set_vsync(vsync);
+}
+
+FrameScheduler& Renderer::scheduler()
+{
+    return m_scheduler;
 }
\ No newline at end of file
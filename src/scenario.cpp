@@ -0,0 +1,470 @@
+#include "../include/scenario.h"
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+
+namespace {
+    constexpr char map_magic[8] = {'W', 'S', 'M', 'A', 'P', '0', '0', '1'};
+    constexpr int bucket_rows = 32;  // Rows sharing one list of candidate shapes
+
+    // FNV-1a over the bytes of each value
+    class Hasher {
+    public:
+        template <typename T>
+        void add(const T& value) {
+            unsigned char bytes[sizeof(T)];
+            std::memcpy(bytes, &value, sizeof(T));
+            for (const unsigned char byte : bytes) {
+                m_hash = (m_hash ^ byte) * 1099511628211ull;
+            }
+        }
+        uint64_t value() const {
+            return m_hash;
+        }
+
+    private:
+        uint64_t m_hash = 1469598103934665603ull;
+    };
+
+    // Part of a row covered by one shape
+    struct Span {
+        int begin;
+        int end;
+        uint32_t order;  // Shape index; later shapes cover earlier ones
+        uint32_t material;
+    };
+
+    // First column whose centre lies at or right of a frame coordinate
+    int column(const double x, const double scale, const int width) {
+        return static_cast<int>(std::clamp(std::ceil(x * scale - 0.5), 0.0, static_cast<double>(width)));
+    }
+
+    // Turn the spans of one row into runs, letting the latest shape win where spans overlap
+    void resolveRow(std::vector<Span>& spans, const int width, std::vector<MaterialMap::Run>& runs,
+                    std::vector<std::pair<int, int>>& events, std::vector<uint32_t>& active) {
+        runs.clear();
+        const auto emit = [&runs](const int end, const uint32_t material) {
+            if (!runs.empty() && runs.back().material == material) {
+                runs.back().end = end;
+            } else {
+                runs.push_back({end, material});
+            }
+        };
+
+        // Event per span edge: column and span index, ends encoded as ~index so they sort first
+        events.clear();
+        for (size_t i = 0; i < spans.size(); i++) {
+            events.emplace_back(spans[i].begin, static_cast<int>(i));
+            events.emplace_back(spans[i].end, ~static_cast<int>(i));
+        }
+        std::sort(events.begin(), events.end());
+
+        active.clear();
+        int x = 0;
+        uint32_t top = 0;  // Material of the latest active span, 0 when none
+        for (size_t e = 0; e < events.size();) {
+            const int at = events[e].first;
+            if (at > x) {
+                emit(at, top);
+                x = at;
+            }
+            for (; e < events.size() && events[e].first == at; e++) {
+                const int span = events[e].second;
+                if (span >= 0) {
+                    active.push_back(static_cast<uint32_t>(span));
+                } else {
+                    active.erase(std::find(active.begin(), active.end(), static_cast<uint32_t>(~span)));
+                }
+            }
+            top = 0;
+            uint32_t latest = 0;
+            for (const uint32_t span : active) {
+                if (top == 0 || spans[span].order >= latest) {
+                    latest = spans[span].order;
+                    top = spans[span].material;
+                }
+            }
+        }
+        if (x < width) {
+            emit(width, top);
+        }
+    }
+
+    void checkMaterial(const Material& material) {
+        if (!(material.porosity >= 0.0f && material.porosity <= 1.0f) ||
+            !(material.speed >= 0.0f && material.speed <= 1.0f) || !(material.damping_rate >= 0.0f)) {
+            std::cerr << "Materials need a porosity and speed between 0 and 1 and a damping rate of at least 0"
+                      << std::endl;
+            exit(1);
+        }
+    }
+}
+
+bool MaterialMap::save(const std::string& path, const uint64_t key) const {
+    const std::string temporary = path + ".tmp";
+    std::FILE* file = std::fopen(temporary.c_str(), "wb");
+    if (file == nullptr) {
+        return false;
+    }
+    const uint32_t material_count = static_cast<uint32_t>(materials.size());
+    bool ok = std::fwrite(map_magic, sizeof(map_magic), 1, file) == 1 && std::fwrite(&key, sizeof(key), 1, file) == 1 &&
+              std::fwrite(&width, sizeof(width), 1, file) == 1 && std::fwrite(&height, sizeof(height), 1, file) == 1 &&
+              std::fwrite(&material_count, sizeof(material_count), 1, file) == 1 &&
+              std::fwrite(materials.data(), sizeof(Material), materials.size(), file) == materials.size();
+    for (const std::vector<Run>& row : rows) {
+        const uint32_t count = static_cast<uint32_t>(row.size());
+        ok = ok && std::fwrite(&count, sizeof(count), 1, file) == 1 &&
+             std::fwrite(row.data(), sizeof(Run), row.size(), file) == row.size();
+    }
+    ok = std::fclose(file) == 0 && ok;
+    if (!ok || std::rename(temporary.c_str(), path.c_str()) != 0) {
+        std::remove(temporary.c_str());
+        return false;
+    }
+    return true;
+}
+
+bool MaterialMap::load(const std::string& path, const uint64_t key) {
+    std::FILE* file = std::fopen(path.c_str(), "rb");
+    if (file == nullptr) {
+        return false;
+    }
+    MaterialMap map;
+    char magic[sizeof(map_magic)];
+    uint64_t stored_key = 0;
+    uint32_t material_count = 0;
+    bool ok = std::fread(magic, sizeof(magic), 1, file) == 1 && std::memcmp(magic, map_magic, sizeof(magic)) == 0 &&
+              std::fread(&stored_key, sizeof(stored_key), 1, file) == 1 && stored_key == key &&
+              std::fread(&map.width, sizeof(map.width), 1, file) == 1 &&
+              std::fread(&map.height, sizeof(map.height), 1, file) == 1 && map.width > 0 && map.height > 0 &&
+              std::fread(&material_count, sizeof(material_count), 1, file) == 1 && material_count > 0;
+    if (ok) {
+        map.materials.resize(material_count);
+        ok = std::fread(map.materials.data(), sizeof(Material), material_count, file) == material_count;
+    }
+    if (ok) {
+        map.rows.resize(map.height);
+    }
+    for (int y = 0; ok && y < map.height; y++) {
+        uint32_t count = 0;
+        ok = std::fread(&count, sizeof(count), 1, file) == 1 && count > 0 && count <= static_cast<uint32_t>(map.width);
+        if (ok) {
+            map.rows[y].resize(count);
+            ok = std::fread(map.rows[y].data(), sizeof(Run), count, file) == count;
+        }
+        // Runs must cover the row left to right with known materials
+        int x = 0;
+        for (size_t i = 0; ok && i < map.rows[y].size(); i++) {
+            ok = map.rows[y][i].end > x && map.rows[y][i].material < material_count;
+            x = map.rows[y][i].end;
+        }
+        ok = ok && x == map.width;
+    }
+    std::fclose(file);
+    if (ok) {
+        *this = std::move(map);
+    }
+    return ok;
+}
+
+Scenario::Scenario() : m_frame_width(0.0), m_frame_height(0.0), m_materials{{1.0f, 1.0f, 0.0f}} {
+}
+
+Scenario Scenario::parse(const std::string& text, const std::string& source) {
+    Scenario scenario;
+    std::istringstream lines(text);
+    std::string line;
+    int number = 0;
+    while (std::getline(lines, line)) {
+        number++;
+        const auto fail = [&](const std::string& message) {
+            std::cerr << source << ":" << number << ": " << message << std::endl;
+            exit(1);
+        };
+        line = line.substr(0, line.find('#'));
+        std::istringstream words(line);
+        std::string statement;
+        if (!(words >> statement)) {
+            continue;
+        }
+
+        // Numbers up to the first attribute name, then name and value pairs
+        std::vector<double> numbers;
+        double number_value;
+        while (words >> number_value) {
+            numbers.push_back(number_value);
+        }
+        words.clear();
+        Material material = {0.0f, 1.0f, 0.0f};
+        bool porosity_set = false;
+        bool speed_set = false;
+        bool water_set = false;
+        std::string attribute;
+        while (words >> attribute) {
+            double value;
+            if (!(words >> value)) {
+                fail("missing value for " + attribute);
+            }
+            if (attribute == "porosity") {
+                material.porosity = static_cast<float>(value);
+                porosity_set = true;
+            } else if (attribute == "speed" || attribute == "depth") {
+                if (speed_set) {
+                    fail("speed and depth both given");
+                }
+                material.speed = static_cast<float>(attribute == "depth" ? std::sqrt(std::max(value, 0.0)) : value);
+                speed_set = true;
+                water_set = true;
+                if (attribute == "depth" && !(value >= 0.0 && value <= 1.0)) {
+                    fail("depth must lie between 0 and 1");
+                }
+            } else if (attribute == "damping") {
+                material.damping_rate = static_cast<float>(value);
+                water_set = true;
+            } else {
+                fail("unknown attribute " + attribute);
+            }
+        }
+        if (statement == "grid" && (porosity_set || water_set)) {
+            fail("grid takes no attributes");
+        }
+        if (!porosity_set && water_set) {
+            material.porosity = 1.0f;
+        }
+        if (!(material.porosity >= 0.0f && material.porosity <= 1.0f) ||
+            !(material.speed >= 0.0f && material.speed <= 1.0f) || !(material.damping_rate >= 0.0f)) {
+            fail("porosity and speed must lie between 0 and 1, damping must not be negative");
+        }
+
+        if (statement == "grid") {
+            if (numbers.size() != 2 || !(numbers[0] > 0.0 && numbers[1] > 0.0)) {
+                fail("grid needs a positive width and height");
+            }
+            scenario.set_frame(numbers[0], numbers[1]);
+        } else if (statement == "polygon") {
+            if (numbers.size() < 6 || numbers.size() % 2 != 0) {
+                fail("polygon needs at least three X Y points");
+            }
+            std::vector<Point> points;
+            for (size_t i = 0; i < numbers.size(); i += 2) {
+                points.push_back({numbers[i], numbers[i + 1]});
+            }
+            scenario.add_polygon(points, material);
+        } else if (statement == "circle") {
+            if (numbers.size() != 3 || !(numbers[2] > 0.0)) {
+                fail("circle needs X Y and a positive radius");
+            }
+            scenario.add_circle({numbers[0], numbers[1]}, numbers[2], material);
+        } else if (statement == "breakwater") {
+            if (numbers.size() != 5 || !(numbers[4] > 0.0) || (numbers[0] == numbers[2] && numbers[1] == numbers[3])) {
+                fail("breakwater needs two distinct X Y end points and a positive width");
+            }
+            scenario.add_breakwater({numbers[0], numbers[1]}, {numbers[2], numbers[3]}, numbers[4], material);
+        } else {
+            fail("unknown statement " + statement);
+        }
+    }
+    return scenario;
+}
+
+Scenario Scenario::load(const std::string& path) {
+    std::ifstream in(path, std::ios::binary);
+    if (!in) {
+        std::cerr << "Could not open scenario " << path << std::endl;
+        exit(1);
+    }
+    std::ostringstream text;
+    text << in.rdbuf();
+    return parse(text.str(), path);
+}
+
+Scenario Scenario::sierpinski_carpet(const int x, const int y, const int size, const int level, const float porosity) {
+    Scenario scenario;
+    const Material material = {porosity, 1.0f, 0.0f};
+
+    // Squares still to split, so the depth costs no stack
+    std::vector<std::array<int, 4>> pending = {{x, y, size, level}};
+    while (!pending.empty()) {
+        const auto [left, top, edge, depth] = pending.back();
+        pending.pop_back();
+        if (depth == 0 || edge < 3) {
+            continue;
+        }
+        const int third = edge / 3;
+        const double x0 = left + third;
+        const double y0 = top + third;
+        scenario.add_polygon({{x0, y0}, {x0 + third, y0}, {x0 + third, y0 + third}, {x0, y0 + third}}, material);
+        for (int dy = 0; dy < 3; dy++) {
+            for (int dx = 0; dx < 3; dx++) {
+                if (dx != 1 || dy != 1) {
+                    pending.push_back({left + dx * third, top + dy * third, third, depth - 1});
+                }
+            }
+        }
+    }
+    return scenario;
+}
+
+void Scenario::set_frame(const double width, const double height) {
+    m_frame_width = width;
+    m_frame_height = height;
+}
+
+uint32_t Scenario::materialIndex(const Material& material) {
+    checkMaterial(material);
+    const auto found = std::find(m_materials.begin() + 1, m_materials.end(), material);
+    if (found != m_materials.end()) {
+        return static_cast<uint32_t>(found - m_materials.begin());
+    }
+    m_materials.push_back(material);
+    return static_cast<uint32_t>(m_materials.size() - 1);
+}
+
+void Scenario::addShape(Shape shape) {
+    m_shapes.push_back(shape);
+}
+
+void Scenario::add_polygon(const std::vector<Point>& points, const Material& material) {
+    Shape shape = {ShapeKind::Polygon, materialIndex(material), m_points.size(), points.size(), {}, 0.0,
+                   points.empty() ? 0.0 : points[0].y, points.empty() ? 0.0 : points[0].y};
+    for (const Point& point : points) {
+        shape.y_min = std::min(shape.y_min, point.y);
+        shape.y_max = std::max(shape.y_max, point.y);
+        m_points.push_back(point);
+    }
+    addShape(shape);
+}
+
+void Scenario::add_circle(const Point centre, const double radius, const Material& material) {
+    addShape({ShapeKind::Circle, materialIndex(material), 0, 0, centre, radius, centre.y - radius, centre.y + radius});
+}
+
+void Scenario::add_breakwater(const Point from, const Point to, const double width, const Material& material) {
+    // Rectangle around the segment, half the width to each side
+    const double length = std::hypot(to.x - from.x, to.y - from.y);
+    const double nx = length > 0.0 ? -(to.y - from.y) / length * width / 2 : 0.0;
+    const double ny = length > 0.0 ? (to.x - from.x) / length * width / 2 : 0.0;
+    add_polygon({{from.x + nx, from.y + ny}, {to.x + nx, to.y + ny}, {to.x - nx, to.y - ny}, {from.x - nx, from.y - ny}},
+                material);
+}
+
+size_t Scenario::shapes() const {
+    return m_shapes.size();
+}
+
+uint64_t Scenario::hash(const int width, const int height) const {
+    Hasher hasher;
+    hasher.add(uint32_t{1});  // Format version of the rasterized map
+    hasher.add(width);
+    hasher.add(height);
+    hasher.add(m_frame_width);
+    hasher.add(m_frame_height);
+    for (const Shape& shape : m_shapes) {
+        const Material& material = m_materials[shape.material];
+        hasher.add(shape.kind);
+        hasher.add(material.porosity);
+        hasher.add(material.speed);
+        hasher.add(material.damping_rate);
+        if (shape.kind == ShapeKind::Circle) {
+            hasher.add(shape.centre.x);
+            hasher.add(shape.centre.y);
+            hasher.add(shape.radius);
+        } else {
+            hasher.add(shape.point_count);
+            for (size_t i = 0; i < shape.point_count; i++) {
+                hasher.add(m_points[shape.first_point + i].x);
+                hasher.add(m_points[shape.first_point + i].y);
+            }
+        }
+    }
+    return hasher.value();
+}
+
+MaterialMap Scenario::map(const int width, const int height) const {
+    MaterialMap map;
+    map.width = width;
+    map.height = height;
+    map.materials = m_materials;
+    map.rows.resize(height);
+    return map;
+}
+
+void Scenario::rasterize(MaterialMap& map, const int y_begin, const int y_end) const {
+    if (y_begin >= y_end) {
+        return;
+    }
+    const double scale_x = m_frame_width > 0.0 ? map.width / m_frame_width : 1.0;
+    const double scale_y = m_frame_height > 0.0 ? map.height / m_frame_height : 1.0;
+
+    // Candidate shapes per bucket of rows, in painting order
+    const int buckets = (y_end - y_begin + bucket_rows - 1) / bucket_rows;
+    std::vector<std::vector<uint32_t>> candidates(buckets);
+    for (size_t i = 0; i < m_shapes.size(); i++) {
+        // Rows whose centre can lie in [y_min, y_max], with a row to spare for rounding
+        const double first = std::floor(m_shapes[i].y_min * scale_y - 0.5);
+        const double last = std::ceil(m_shapes[i].y_max * scale_y - 0.5);
+        const int from = static_cast<int>(std::clamp(first, static_cast<double>(y_begin), static_cast<double>(y_end)));
+        const int to = static_cast<int>(std::clamp(last + 1.0, static_cast<double>(y_begin), static_cast<double>(y_end)));
+        if (from < to) {
+            for (int b = (from - y_begin) / bucket_rows; b <= (to - 1 - y_begin) / bucket_rows; b++) {
+                candidates[b].push_back(static_cast<uint32_t>(i));
+            }
+        }
+    }
+
+    std::vector<Span> spans;
+    std::vector<double> crossings;
+    std::vector<std::pair<int, int>> events;
+    std::vector<uint32_t> active;
+    std::vector<MaterialMap::Run> runs;
+    for (int y = y_begin; y < y_end; y++) {
+        const double centre_y = (y + 0.5) / scale_y;
+        const auto cover = [&](const double x0, const double x1, const uint32_t order, const uint32_t material) {
+            const int begin = column(x0, scale_x, map.width);
+            const int end = column(x1, scale_x, map.width);
+            if (begin < end) {
+                spans.push_back({begin, end, order, material});
+            }
+        };
+
+        spans.clear();
+        for (const uint32_t index : candidates[(y - y_begin) / bucket_rows]) {
+            const Shape& shape = m_shapes[index];
+            if (centre_y < shape.y_min || centre_y > shape.y_max) {
+                continue;
+            }
+            if (shape.kind == ShapeKind::Circle) {
+                const double dy = centre_y - shape.centre.y;
+                if (dy * dy < shape.radius * shape.radius) {
+                    const double half = std::sqrt(shape.radius * shape.radius - dy * dy);
+                    cover(shape.centre.x - half, shape.centre.x + half, index, shape.material);
+                }
+                continue;
+            }
+
+            // Even-odd rule: an edge counts when exactly one end lies at or above the row centre
+            crossings.clear();
+            const Point* points = m_points.data() + shape.first_point;
+            for (size_t i = 0; i < shape.point_count; i++) {
+                const Point& a = points[i];
+                const Point& b = points[(i + 1) % shape.point_count];
+                if ((a.y <= centre_y) != (b.y <= centre_y)) {
+                    crossings.push_back(a.x + (centre_y - a.y) * (b.x - a.x) / (b.y - a.y));
+                }
+            }
+            std::sort(crossings.begin(), crossings.end());
+            for (size_t i = 0; i + 1 < crossings.size(); i += 2) {
+                cover(crossings[i], crossings[i + 1], index, shape.material);
+            }
+        }
+
+        resolveRow(spans, map.width, runs, events, active);
+        map.rows[y] = runs;
+    }
+}
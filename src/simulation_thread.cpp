@@ -0,0 +1,106 @@
+#include "../include/simulation_thread.h"
+
+#include <algorithm>
+#include <chrono>
+
+namespace {
+    // Steps between snapshots when running as fast as possible
+    constexpr int free_run_batch = 32;
+
+    // Drop simulation debt beyond this in real-time mode instead of falling further behind
+    constexpr double max_lag = 0.05;
+}
+
+SimulationThread::SimulationThread(Fluid<>& fluid, const float halflife)
+    : m_fluid(fluid), m_halflife(halflife), m_running(false), m_realtime(false),
+      m_lag(0.0), m_last(std::chrono::steady_clock::now())
+{
+}
+
+SimulationThread::~SimulationThread() {
+    stop();
+}
+
+void SimulationThread::start() {
+    if (m_running.exchange(true)) {
+        return;
+    }
+    m_thread = std::thread(&SimulationThread::run, this);
+}
+
+void SimulationThread::stop() {
+    m_running.store(false);
+    if (m_thread.joinable()) {
+        m_thread.join();
+    }
+}
+
+void SimulationThread::add_velocity(const int x, const int y) {
+    std::lock_guard<std::mutex> lock(m_input_mutex);
+    m_splashes.emplace_back(x, y);
+}
+
+void SimulationThread::set_realtime(const bool realtime) {
+    m_realtime.store(realtime, std::memory_order_relaxed);
+}
+
+bool SimulationThread::realtime() const {
+    return m_realtime.load(std::memory_order_relaxed);
+}
+
+const FluidSnapshot<>* SimulationThread::latest() {
+    m_snapshots.update();
+    const FluidSnapshot<>& snapshot = m_snapshots.front();
+    return snapshot.width() > 0 ? &snapshot : nullptr;
+}
+
+void SimulationThread::applyInput() {
+    {
+        std::lock_guard<std::mutex> lock(m_input_mutex);
+        if (m_splashes.empty()) {
+            return;
+        }
+        m_applying.swap(m_splashes);
+    }
+    for (const auto& [x, y] : m_applying) {
+        m_fluid.add_velocity(x, y);
+    }
+    m_applying.clear();
+}
+
+bool SimulationThread::pump() {
+    WAVESIM_ZONE("pump");
+    applyInput();
+
+    const auto now = std::chrono::steady_clock::now();
+    const double elapsed = std::chrono::duration<double>(now - m_last).count();
+    m_last = now;
+
+    if (m_realtime.load(std::memory_order_relaxed)) {
+        m_lag = std::min(m_lag + elapsed, max_lag);
+        const int substeps = static_cast<int>(m_lag / m_fluid.dt());
+        if (substeps == 0) {
+            return false;
+        }
+        m_fluid.advance(substeps, m_halflife);
+        m_lag -= substeps * m_fluid.dt();
+    } else {
+        m_lag = 0.0;
+        m_fluid.advance(free_run_batch, m_halflife);
+    }
+
+    m_fluid.capture(m_snapshots.back());
+    m_snapshots.publish();
+    return true;
+}
+
+void SimulationThread::run() {
+    profiler::set_thread_name("simulation");
+    m_last = std::chrono::steady_clock::now();
+    while (m_running.load(std::memory_order_acquire)) {
+        if (!pump()) {
+            // Ahead of the clock; wait for about one step's worth of wall time
+            std::this_thread::sleep_for(std::chrono::duration<double>(m_fluid.dt() - m_lag));
+        }
+    }
+}
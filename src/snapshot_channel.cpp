@@ -0,0 +1,88 @@
+#include "../include/snapshot_channel.h"
+
+#include <iostream>
+
+SnapshotChannel::SnapshotChannel(const int source_width, const int source_height, const int downsample,
+                                 const int capacity, const int cadence)
+    : m_source_width(source_width), m_source_height(source_height), m_downsample(downsample), m_cadence(cadence),
+      m_width(0), m_height(0), m_written(0), m_released(0), m_dropped(0)
+{
+    if (source_width <= 0 || source_height <= 0 || downsample <= 0 || capacity <= 0 || cadence <= 0) {
+        std::cerr << "Snapshot channel sizes, capacity and cadence must be positive" << std::endl;
+        exit(1);
+    }
+
+    m_width = (source_width + downsample - 1) / downsample;
+    m_height = (source_height + downsample - 1) / downsample;
+
+    m_frames.resize(capacity);
+    for (SnapshotFrame& frame : m_frames) {
+        frame.heights.assign(static_cast<size_t>(m_width) * m_height, 0.0f);
+    }
+}
+
+int SnapshotChannel::source_width() const {
+    return m_source_width;
+}
+
+int SnapshotChannel::source_height() const {
+    return m_source_height;
+}
+
+int SnapshotChannel::downsample() const {
+    return m_downsample;
+}
+
+int SnapshotChannel::cadence() const {
+    return m_cadence;
+}
+
+int SnapshotChannel::width() const {
+    return m_width;
+}
+
+int SnapshotChannel::height() const {
+    return m_height;
+}
+
+SnapshotFrame* SnapshotChannel::begin_write() {
+    const uint64_t written = m_written.load(std::memory_order_relaxed);
+    const uint64_t released = m_released.load(std::memory_order_acquire);
+    if (written - released == m_frames.size()) {
+        m_dropped.fetch_add(1, std::memory_order_relaxed);
+        return nullptr;
+    }
+    return &m_frames[written % m_frames.size()];
+}
+
+void SnapshotChannel::end_write() {
+    m_written.store(m_written.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+}
+
+const SnapshotFrame* SnapshotChannel::read() {
+    const uint64_t released = m_released.load(std::memory_order_relaxed);
+    const uint64_t written = m_written.load(std::memory_order_acquire);
+    if (released == written) {
+        return nullptr;
+    }
+    return &m_frames[released % m_frames.size()];
+}
+
+const SnapshotFrame* SnapshotChannel::read_latest() {
+    const uint64_t released = m_released.load(std::memory_order_relaxed);
+    const uint64_t written = m_written.load(std::memory_order_acquire);
+    if (released == written) {
+        return nullptr;
+    }
+    // Hand the skipped frames back so the producer can reuse them
+    m_released.store(written - 1, std::memory_order_release);
+    return &m_frames[(written - 1) % m_frames.size()];
+}
+
+void SnapshotChannel::release() {
+    m_released.store(m_released.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+}
+
+uint64_t SnapshotChannel::dropped() const {
+    return m_dropped.load(std::memory_order_relaxed);
+}
@@ -0,0 +1,82 @@
+#include "../include/thread_pool.h"
+#include "../include/profiler.h"
+
+#include <algorithm>
+
+ThreadPool::ThreadPool(const int threads)
+    : m_size(std::max(1, threads)),
+      m_job(nullptr),
+      m_generation(0),
+      m_pending(0),
+      m_stopping(false),
+      m_barrier(m_size)
+{
+    m_workers.reserve(m_size - 1);
+    for (int i = 1; i < m_size; i++) {
+        m_workers.emplace_back(&ThreadPool::workerLoop, this, i);
+    }
+}
+
+ThreadPool::~ThreadPool() {
+    {
+        std::lock_guard lock(m_mutex);
+        m_stopping = true;
+    }
+    m_start.notify_all();
+
+    for (std::thread& worker : m_workers) {
+        worker.join();
+    }
+}
+
+int ThreadPool::size() const {
+    return m_size;
+}
+
+void ThreadPool::run(const std::function<void(int)>& job) {
+    {
+        std::lock_guard lock(m_mutex);
+        m_job = &job;
+        m_pending = m_size - 1;
+        m_generation++;
+    }
+    m_start.notify_all();
+
+    // The caller does its share instead of idling
+    job(0);
+
+    std::unique_lock lock(m_mutex);
+    m_done.wait(lock, [this] { return m_pending == 0; });
+    m_job = nullptr;
+}
+
+void ThreadPool::barrier() {
+    m_barrier.arrive_and_wait();
+}
+
+void ThreadPool::workerLoop(const int index) {
+    profiler::set_thread_name("pool worker");
+    uint64_t seen = 0;
+
+    while (true) {
+        const std::function<void(int)>* job;
+        {
+            std::unique_lock lock(m_mutex);
+            m_start.wait(lock, [this, seen] { return m_stopping || m_generation != seen; });
+            if (m_stopping) {
+                return;
+            }
+            seen = m_generation;
+            job = m_job;
+        }
+
+        (*job)(index);
+
+        {
+            std::lock_guard lock(m_mutex);
+            if (--m_pending == 0) {
+                m_done.notify_one();
+            }
+        }
+    }
+}
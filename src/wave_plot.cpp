@@ -0,0 +1,98 @@
+#include "../include/wave_plot.h"
+#include "../include/matplotlibcpp.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace plt = matplotlibcpp;
+
+static void mapHeightToColor(const float height, unsigned char* r, unsigned char* g, unsigned char* b) {
+    // Normalize height for color mapping (between 0 and 1)
+    const float normHeight = std::clamp((height - 1.0f) / (10.0f - 1.0f), 0.0f, 1.0f);
+
+    // Blue for low heights, red for high heights
+    *r = static_cast<unsigned char>(255.0f * normHeight);                // Red increases with height
+    *g = static_cast<unsigned char>(std::max(0.0f, 255.0f * (1.0f - 2.0f * std::abs(normHeight - 0.5f)))); // Green peaks in middle
+    *b = static_cast<unsigned char>(255.0f * (1.0f - normHeight));       // Blue decreases with height
+}
+
+void plot_waves(SnapshotChannel& channel, const std::atomic<bool>& running) {
+    const int height = channel.height();
+    const int width = channel.width();
+    std::vector<unsigned char> image_data(height * width * 3);  // RGB values, reused for every frame
+
+    while (running.load()) {
+        const SnapshotFrame* frame = channel.read_latest();
+        if (frame == nullptr) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+            continue;
+        }
+
+        // Generate height-mapped image
+        for (int y = 0; y < height; y++) {
+            for (int x = 0; x < width; x++) {
+                const int idx = y * width + x;
+                mapHeightToColor(frame->heights[idx],
+                                 &image_data[idx * 3],
+                                 &image_data[idx * 3 + 1],
+                                 &image_data[idx * 3 + 2]);
+            }
+        }
+        channel.release();
+
+        // Render the image
+        plt::imshow(image_data.data(), height, width, 3);
+        plt::pause(0.05);  // Pause for smooth update
+    }
+}
+
+void plot_gauges(ProbeRecorder& recorder, const double dt, const std::atomic<bool>& running) {
+    // Keep one point per 48 substeps (1 ms at the default timestep) for the last second
+    constexpr int decimation = 48;
+    constexpr size_t history = 1000;
+    const int probes = recorder.probes();
+
+    std::vector<double> times(history, 0.0);
+    std::vector<std::vector<double>> heights(probes, std::vector<double>(history, 0.0));
+    size_t filled = 0;
+
+    while (running.load()) {
+        recorder.drain([&](const uint64_t step, const float* values, const float*) {
+            if (step % decimation != 0) {
+                return;
+            }
+            // Scroll left by one point once the window is full
+            if (filled == history) {
+                std::rotate(times.begin(), times.begin() + 1, times.end());
+                for (std::vector<double>& series : heights) {
+                    std::rotate(series.begin(), series.begin() + 1, series.end());
+                }
+                filled--;
+            }
+            times[filled] = step * dt;
+            for (int k = 0; k < probes; k++) {
+                heights[k][filled] = values[k];
+            }
+            filled++;
+        });
+
+        if (filled < 2) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+            continue;
+        }
+
+        plt::clf();
+        for (int k = 0; k < probes; k++) {
+            const std::vector<double> t(times.begin(), times.begin() + filled);
+            const std::vector<double> h(heights[k].begin(), heights[k].begin() + filled);
+            plt::named_plot("probe " + std::to_string(k), t, h);
+        }
+        plt::xlabel("time (s)");
+        plt::legend();
+        plt::pause(0.05);
+    }
+}
@@ -0,0 +1,58 @@
+# Runs wavesim_headless in every step mode with every kernel set and precision, on one
+# and on several threads, and fails unless each precision gives a single checksum.
+# Usage: cmake -DHEADLESS=<path> -DARGS="<options>" -P step_modes.cmake
+
+if (NOT HEADLESS)
+    message(FATAL_ERROR "HEADLESS must name the wavesim_headless executable")
+endif ()
+separate_arguments(ARGS)
+
+set(MODES three-pass fused blocked sparse)
+set(THREADS 1 3)
+
+# Returns the checksum line of one run in OUT, or fails the test
+function(run_headless OUT)
+    execute_process(COMMAND ${HEADLESS} ${ARGS} ${ARGN}
+                    OUTPUT_VARIABLE output ERROR_VARIABLE error RESULT_VARIABLE result)
+    if (NOT result EQUAL 0)
+        message(FATAL_ERROR "wavesim_headless ${ARGN} failed:\n${error}")
+    endif ()
+    string(REGEX MATCH "checksum +[^\n]+" checksum "${output}")
+    if (NOT checksum)
+        message(FATAL_ERROR "wavesim_headless ${ARGN} printed no checksum:\n${output}")
+    endif ()
+    set(${OUT} "${checksum}" PARENT_SCOPE)
+endfunction()
+
+# Each configuration: precision, then kernel set or "default"
+set(CONFIGS float:scalar float:sse float:avx2 float:avx512 double:default half:default)
+foreach (config IN LISTS CONFIGS)
+    string(REPLACE ":" ";" parts "${config}")
+    list(GET parts 0 precision)
+    list(GET parts 1 kernels)
+    set(options --precision ${precision})
+    if (NOT kernels STREQUAL "default")
+        # Kernel sets the CPU or compiler lacks are skipped
+        execute_process(COMMAND ${HEADLESS} --steps 1 --kernels ${kernels}
+                        OUTPUT_QUIET ERROR_QUIET RESULT_VARIABLE supported)
+        if (NOT supported EQUAL 0)
+            message(STATUS "${kernels}: not supported here, skipped")
+            continue()
+        endif ()
+        list(APPEND options --kernels ${kernels})
+    endif ()
+
+    foreach (mode IN LISTS MODES)
+        foreach (threads IN LISTS THREADS)
+            run_headless(checksum ${options} --mode ${mode} --threads ${threads})
+            message(STATUS "${config} ${mode} ${threads} threads: ${checksum}")
+            if (NOT DEFINED reference_${precision})
+                set(reference_${precision} "${checksum}")
+                set(reference_run_${precision} "${config} ${mode} ${threads} threads")
+            elseif (NOT checksum STREQUAL reference_${precision})
+                message(FATAL_ERROR "${config} ${mode} on ${threads} threads gave ${checksum}, "
+                                    "${reference_run_${precision}} gave ${reference_${precision}}")
+            endif ()
+        endforeach ()
+    endforeach ()
+endforeach ()